@@ -37,7 +37,7 @@ void Client::update(int round_index, double learning_rate, size_t batch_size, si
     int epoch = 0;
     auto on_enumerate_epoch = [&]()
     {
-        metrics::Metrics metrics = model->evaluate();
+        metrics::Metrics metrics = evaluate();
         log_metrics(round_index, id, epoch, DatasetType::LOCAL, metrics);
         spdlog::debug("Client {} epoch {} accuracy: {}, loss {}.", id, epoch, metrics.accuracy, metrics.loss);
         epoch++;
@@ -46,7 +46,7 @@ void Client::update(int round_index, double learning_rate, size_t batch_size, si
     model->train(epochs, batch_size, learning_rate, on_enumerate_epoch);
 
     // Evaluate the model and store the metrics
-    auto metrics = model->evaluate();
+    auto metrics = evaluate();
     history.push_back(metrics);
 
     // Update round count and store the round index
@@ -55,6 +55,19 @@ void Client::update(int round_index, double learning_rate, size_t batch_size, si
     spdlog::info("Done updating client: {}.", id);
 }
 
+metrics::Metrics Client::evaluate()
+{
+    const uint64_t version = model->weights_version();
+    if (version == evaluated_version)
+    {
+        spdlog::debug("Client {} reuses the metrics of model version {}.", id, version);
+        return evaluated_metrics;
+    }
+    evaluated_metrics = model->evaluate();
+    evaluated_version = version;
+    return evaluated_metrics;
+}
+
 void Client::logRounds() const
 {
     std::ostringstream oss;
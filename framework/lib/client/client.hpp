@@ -25,10 +25,17 @@ public:
     // Update the client with a new training round
     void update(int round_index, double learning_rate, size_t batch_size, size_t epochs);
 
+    // Evaluate the model, reusing the metrics of the last evaluation if the weights did not change since
+    metrics::Metrics evaluate();
+
     void logRounds() const;
 
     void logMetrics() const;
 
+private:
+    // Metrics of the last evaluation of the model on the local test set and the version of the evaluated weights.
+    uint64_t evaluated_version = 0; // no model takes version 0
+    metrics::Metrics evaluated_metrics;
 };
 
 #endif // CLIENT_HPP
@@ -37,6 +37,8 @@ namespace config
         float learning_rate = 0.01;
         int batch_size = 32;
         int epochs = 5;
+        bool pipelined = false;
+        int prefetch_batches = 2;
     }
 
     namespace orchestration
@@ -46,6 +48,12 @@ namespace config
         float c_rate = 0.1;
         float checkpoint_rate = 0.2;
         bool threaded = false;
+        int worker_threads = 0;
+        int eval_threads = 1;
+        bool weight_dispersion = false;
+        bool pipelined_rounds = false;
+        bool async_mode = false;
+        size_t async_buffer = 0;
     }
 
     namespace parameters
@@ -93,12 +101,21 @@ void config::save_config_to_file() {
             {"num_clients", orchestration::num_clients},
             {"num_rounds", orchestration::num_rounds},
             {"c_rate", orchestration::c_rate},
-            {"checkpoint_rate", orchestration::checkpoint_rate}
+            {"checkpoint_rate", orchestration::checkpoint_rate},
+            {"eval_threads", orchestration::eval_threads},
+            {"threaded", orchestration::threaded},
+            {"worker_threads", orchestration::worker_threads},
+            {"weight_dispersion", orchestration::weight_dispersion},
+            {"pipelined_rounds", orchestration::pipelined_rounds},
+            {"async_mode", orchestration::async_mode},
+            {"async_buffer", orchestration::async_buffer}
         }},
         {"training", {
             {"learning_rate", training::learning_rate},
             {"batch_size", training::batch_size},
-            {"epochs", training::epochs}
+            {"epochs", training::epochs},
+            {"pipelined", training::pipelined},
+            {"prefetch_batches", training::prefetch_batches}
         }},
         {"parameters", {
             {"num_classes", parameters::num_classes},
@@ -157,10 +174,13 @@ void config::log_simulation_params()
     spdlog::info("Number of rounds: {}", orchestration::num_rounds);
     spdlog::info("Client selection rate: {}", orchestration::c_rate);
     spdlog::info("Checkpoint rate: {}", orchestration::checkpoint_rate);
+    spdlog::info("Evaluation threads: {}", orchestration::eval_threads);
     spdlog::info("Training parameters:");
     spdlog::info("Learning rate: {}", training::learning_rate);
     spdlog::info("Batch size: {}", training::batch_size);
     spdlog::info("Epochs: {}", training::epochs);
+    spdlog::info("Pipelined training: [{}]", training::pipelined ? "enabled" : "disabled");
+    spdlog::info("Prefetched batches: {}", training::prefetch_batches);
     spdlog::info("Model parameters:");
     switch (model_type)
     {
@@ -198,6 +218,11 @@ void config::log_simulation_params()
         return units_str; }());
     spdlog::info("Number of classes: {}", parameters::num_classes);
     spdlog::info("Threaded mode: [{}]", orchestration::threaded ? "enabled" : "disabled");
+    spdlog::info("Worker threads: {}", orchestration::worker_threads == 0 ? std::string("one per core") : std::to_string(orchestration::worker_threads));
+    spdlog::info("Weight dispersion: [{}]", orchestration::weight_dispersion ? "enabled" : "disabled");
+    spdlog::info("Pipelined rounds: [{}]", orchestration::pipelined_rounds ? "enabled" : "disabled");
+    spdlog::info("Asynchronous mode: [{}]", orchestration::async_mode ? "enabled" : "disabled");
+    spdlog::info("Asynchronous buffer: {}", orchestration::async_buffer == 0 ? std::string("one update per concurrent client") : std::to_string(orchestration::async_buffer));
     spdlog::info("Finished logging simulation parameters\n");
 }
 
@@ -46,6 +46,8 @@ namespace config
         extern float learning_rate;
         extern int batch_size;
         extern int epochs;
+        extern bool pipelined; // train the cells of a FF model in a pipeline, one thread per cell
+        extern int prefetch_batches; // batches of a FF model generated ahead by a background thread, 0 to disable
     }
 
     namespace orchestration
@@ -55,6 +57,12 @@ namespace config
         extern float c_rate;
         extern float checkpoint_rate;
         extern bool threaded;
+        extern int worker_threads; // threads of the worker pool running the clients in threaded mode, 0 for one per core
+        extern int eval_threads; // threads used to evaluate a model
+        extern bool weight_dispersion; // log the dispersion of the client models around the aggregated one
+        extern bool pipelined_rounds; // evaluate and checkpoint a round in the background while the next one trains
+        extern bool async_mode; // clients train continuously and the server aggregates every async_buffer updates, for num_rounds aggregations
+        extern size_t async_buffer; // updates buffered before an asynchronous aggregation, 0 for one per concurrent client
     }
 
     namespace parameters
@@ -4,9 +4,18 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <config/config.hpp>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #define METRICS_LOGGER_NAME "metrics_logger"
 
+static std::mutex rows_mutex;                              // Protects the rows held back and the open round.
+static int open_round = 0;                                 // Last round whose rows are written as soon as they are logged.
+static std::map<int, std::vector<std::string>> held_rows;  // Rows of the rounds after the open one, by round.
+
 void init_metrics_logger()
 {
     // Create a file sink
@@ -23,8 +32,28 @@ void init_metrics_logger()
 
 void log_metrics(const int round_num, const int client_id, const int epoch, const DatasetType dataset_type, const metrics::Metrics &metrics)
 {
+    std::string row = fmt::format("{},{},{},{},{},{},{},{},{}", round_num, client_id, epoch, static_cast<int>(dataset_type), metrics.accuracy, metrics.average_f1_score, metrics.average_precision, metrics.average_recall, metrics.loss);
+    std::lock_guard<std::mutex> lock(rows_mutex);
+    if (round_num > open_round)
+    {
+        held_rows[round_num].push_back(std::move(row));
+        return;
+    }
     // Get the metrics logger
     auto logger = spdlog::get(METRICS_LOGGER_NAME);
     // Log the metrics
-    logger->info("{},{},{},{},{},{},{},{},{}", round_num, client_id, epoch, static_cast<int>(dataset_type), metrics.accuracy, metrics.average_f1_score, metrics.average_precision, metrics.average_recall, metrics.loss);
-}
\ No newline at end of file
+    logger->info(row);
+}
+
+void complete_metrics_round(const int round_num)
+{
+    std::lock_guard<std::mutex> lock(rows_mutex);
+    open_round = std::max(open_round, round_num + 1);
+    auto logger = spdlog::get(METRICS_LOGGER_NAME);
+    while (!held_rows.empty() && held_rows.begin()->first <= open_round)
+    {
+        for (const std::string &row : held_rows.begin()->second)
+            logger->info(row);
+        held_rows.erase(held_rows.begin());
+    }
+}
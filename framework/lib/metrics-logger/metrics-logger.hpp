@@ -11,6 +11,11 @@ enum DatasetType
     LOCAL = 1,
 };
 
+// Rows of the rounds after the first uncompleted one are held back until it completes, so that the file
+// stays in round order when the evaluation of a round overlaps the training of the next one.
 void log_metrics(const int round_num, const int client_id, const int epoch, const DatasetType dataset_type, const metrics::Metrics &metrics);
 
+// Marks a round as completed, writing the rows held back for the next round.
+void complete_metrics_round(const int round_num);
+
 #endif // METRICS_LOGGER_HPP
\ No newline at end of file
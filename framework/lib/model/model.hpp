@@ -2,8 +2,11 @@
 #define MODEL_H
 
 #include <vector>
+#include <atomic>
+#include <cstdint>
 #include <metrics.hpp>
 #include <functional>
+#include "span.hpp"
 
 class Model
 {
@@ -22,11 +25,51 @@ public:
     // Evaluate the model's performance with the given test data and labels
     virtual metrics::Metrics evaluate() = 0;
 
-    // Get the model's weights
-    virtual std::vector<double> get_weights() const = 0;
+    // Number of weights of the model
+    virtual size_t num_weights() const = 0;
+
+    // View of the model's weights if the model stores them contiguously as doubles, empty otherwise.
+    // The view is valid until the weights are changed or the model is destroyed.
+    virtual Span<const double> weights_view() const { return {}; }
+
+    // Copy the model's weights into a buffer of num_weights() elements
+    virtual void copy_weights_into(Span<double> weights) const = 0;
+
+    // Set the model's weights from a buffer of num_weights() elements
+    virtual void assign_weights(Span<const double> weights) = 0;
+
+    // View of the model's weights, copied in the buffer only if the model cannot expose its storage
+    Span<const double> view_weights(std::vector<double> &buffer) const
+    {
+        Span<const double> weights = weights_view();
+        if (!weights.empty() || num_weights() == 0)
+            return weights;
+        buffer.resize(num_weights());
+        copy_weights_into(buffer);
+        return buffer;
+    }
+
+    // Get a copy of the model's weights
+    std::vector<double> get_weights() const
+    {
+        std::vector<double> weights(num_weights());
+        copy_weights_into(weights);
+        return weights;
+    }
 
     // Set the model's weights
-    virtual void set_weights(const std::vector<double> &weights) = 0;
+    void set_weights(const std::vector<double> &weights) { assign_weights(weights); }
+
+    // Version of the model's weights, unique in the process: the model takes a new version whenever
+    // its weights change, or the version of the weights it adopts from another model
+    uint64_t weights_version() const { return version; }
+
+    // Set the model's weights to a snapshot of the weights of another model with the given version
+    void adopt_weights(Span<const double> weights, uint64_t weights_version)
+    {
+        assign_weights(weights);
+        version = weights_version;
+    }
 
     // Save the model's weights to a file
     virtual void save(const std::string filename) = 0;
@@ -39,6 +82,13 @@ protected:
     std::vector<int> units;
     float learning_rate;
     int training_epochs;
+
+    // Give the model a new version, called by the implementations whenever they change the weights
+    void bump_weights_version() { version = next_version++; }
+
+private:
+    inline static std::atomic<uint64_t> next_version{1};
+    uint64_t version = next_version++;
 };
 
 #endif // MODEL_H
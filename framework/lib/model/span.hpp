@@ -0,0 +1,38 @@
+#ifndef SPAN_HPP
+#define SPAN_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Non owning view of a contiguous array, a subset of the std::span of C++20.
+template <typename T>
+class Span
+{
+public:
+    constexpr Span() noexcept : pointer(nullptr), count(0) {}
+    constexpr Span(T *data, size_t size) noexcept : pointer(data), count(size) {}
+
+    // View of a vector, a view of const elements also accepts a const vector.
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    Span(std::vector<U> &vector) noexcept : pointer(vector.data()), count(vector.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<const U (*)[], T (*)[]>::value>>
+    Span(const std::vector<U> &vector) noexcept : pointer(vector.data()), count(vector.size()) {}
+
+    // A view of mutable elements converts to a view of const ones.
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr Span(const Span<U> &other) noexcept : pointer(other.data()), count(other.size()) {}
+
+    constexpr T *data() const noexcept { return pointer; }
+    constexpr size_t size() const noexcept { return count; }
+    constexpr bool empty() const noexcept { return count == 0; }
+    constexpr T &operator[](size_t index) const { return pointer[index]; }
+    constexpr T *begin() const noexcept { return pointer; }
+    constexpr T *end() const noexcept { return pointer + count; }
+
+private:
+    T *pointer;
+    size_t count;
+};
+
+#endif // SPAN_HPP
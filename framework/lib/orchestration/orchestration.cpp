@@ -3,6 +3,8 @@
 #include <string>
 #include <filesystem>
 #include <regex>
+#include <mutex>
+#include <random>
 
 #include <orchestration/orchestration.hpp>
 #include <spdlog/spdlog.h>
@@ -18,7 +20,8 @@ using namespace config::orchestration;
 static std::vector<std::string> listFolders(const std::string &folder, const std::string &match);
 
 Orchestrator::Orchestrator(const std::string &datasets_path, const std::string &checkpoints_path, bool threaded) : datasets_path(datasets_path),
-                                                                                                                   checkpoints_path(checkpoints_path)
+                                                                                                                   checkpoints_path(checkpoints_path),
+                                                                                                                   pool(threaded ? std::make_shared<WorkerPool>(worker_threads) : nullptr)
 {
     // Search datasets folders
     std::vector<std::string> data = listFolders(datasets_path, "^client-\\d+$");
@@ -32,7 +35,7 @@ Orchestrator::Orchestrator(const std::string &datasets_path, const std::string &
     clients = initializeClients(data);
 
     // Initialize server
-    server = std::make_shared<Server>(clients, datasets_path + config::global_dataset, threaded);
+    server = std::make_shared<Server>(clients, datasets_path + config::global_dataset, pool);
     // Setup client metrics
     auto _ = evaluateClients(clients);
 }
@@ -55,11 +58,25 @@ std::vector<std::shared_ptr<Client>> Orchestrator::sampleClients()
 
 void Orchestrator::run()
 {
+    if (async_mode)
+    {
+        runAsync();
+        for (auto &client : clients)
+            client->logRounds();
+        return;
+    }
+
     for (round_index = 0; round_index < num_rounds; ++round_index)
     {
         spdlog::info("Running communication round: {}.", round_index);
         std::vector<std::shared_ptr<Client>> round_clients = sampleClients();
 
+        if (pipelined_rounds)
+        {
+            runPipelinedRound(round_clients);
+            continue;
+        }
+
         metrics::Metrics new_model_metrics = server->executeRound(round_index, round_clients);
         spdlog::info("Updated model metrics:\n{}", new_model_metrics.toString());
 
@@ -73,15 +90,123 @@ void Orchestrator::run()
         log_metrics(round_index, -2, -1, DatasetType::LOCAL, global_avg_metrics);
         spdlog::info("Global average accuracy: {}.\n", global_avg_metrics.accuracy);
 
-        if (round_index % std::max(static_cast<int>(num_rounds * checkpoint_rate), 1) == 0 && round_index > 0)
+        if (isCheckpointRound())
             saveCheckpoint();
+        complete_metrics_round(round_index);
     }
+    if (pending_round.valid())
+        pending_round.get();
 
     for (auto &client : clients)
         client->logRounds();
 }
 
+void Orchestrator::runPipelinedRound(const std::vector<std::shared_ptr<Client>> &round_clients)
+{
+    server->trainRound(round_index, round_clients);
+
+    // The client models are only changed by the rounds, so they are evaluated and saved before the next one starts.
+    spdlog::info("Starting round clients evaluation.");
+    metrics::Metrics round_avg_metrics = evaluateClients(round_clients);
+    metrics::Metrics global_avg_metrics = metrics::mean(server->client_metrics);
+    std::string checkpoint_folder = isCheckpointRound() ? saveClientsCheckpoint() : "";
+
+    // The snapshot of the server model is reused, so the previous round must be done with it.
+    if (pending_round.valid())
+        pending_round.get();
+    std::shared_ptr<Model> server_model = server->snapshot();
+
+    const int round = round_index;
+    auto finish_round = [=]()
+    {
+        metrics::Metrics new_model_metrics = server_model->evaluate();
+        log_metrics(round, -1, -1, DatasetType::GLOBAL, new_model_metrics);
+        spdlog::info("Round {} updated model metrics:\n{}", round, new_model_metrics.toString());
+
+        log_metrics(round, -3, config::training::epochs, DatasetType::LOCAL, round_avg_metrics);
+        spdlog::info("Round {} average accuracy: {}.\n", round, round_avg_metrics.accuracy);
+        log_metrics(round, -2, -1, DatasetType::LOCAL, global_avg_metrics);
+        spdlog::info("Round {} global average accuracy: {}.\n", round, global_avg_metrics.accuracy);
+
+        if (!checkpoint_folder.empty())
+            server_model->save(checkpoint_folder + "/model-server.bin");
+        complete_metrics_round(round);
+    };
+    pending_round = pool ? pool->submit(finish_round) : std::async(std::launch::async, finish_round);
+}
+
+void Orchestrator::runAsync()
+{
+    // As many clients train at the same time as are sampled in a synchronous round, at most one per thread.
+    size_t concurrency = std::min(clients.size(), std::max(static_cast<size_t>(1), static_cast<size_t>(c_rate * num_clients)));
+    concurrency = pool ? std::min(concurrency, pool->size() + 1) : 1;
+    spdlog::info("Running {} asynchronous aggregations with {} concurrent clients.", num_rounds, concurrency);
+    server->startAsync(concurrency);
+
+    std::mutex idle_mutex;
+    std::vector<std::shared_ptr<Client>> idle_clients = clients;
+    std::mt19937 generator{std::random_device{}()};
+
+    // Each lane trains a random idle client on the latest server model and pushes its update, until the end.
+    auto run_lane = [&](size_t)
+    {
+        std::vector<double> weights;
+        size_t version = 0;
+        while (true)
+        {
+            std::shared_ptr<Client> client;
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                std::uniform_int_distribution<size_t> distribution(0, idle_clients.size() - 1);
+                const size_t index = distribution(generator);
+                client = idle_clients[index];
+                idle_clients[index] = idle_clients.back();
+                idle_clients.pop_back();
+            }
+            if (!server->pullModel(client, weights, version))
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                idle_clients.push_back(client);
+                break;
+            }
+            client->update(version, config::training::learning_rate, config::training::batch_size, config::training::epochs);
+
+            // The update is the difference between the trained and the pulled weights.
+            std::vector<double> buffer;
+            const Span<const double> trained = client->model->view_weights(buffer);
+            for (size_t j = 0; j < weights.size(); ++j)
+                weights[j] = trained[j] - weights[j];
+            const bool running = server->pushUpdate(client, weights, version);
+
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            idle_clients.push_back(client);
+            if (!running)
+                break;
+        }
+    };
+
+    if (pool)
+        pool->parallel_for(concurrency, run_lane);
+    else
+        run_lane(0);
+
+    // The client models are only idle at the end, so the checkpoint is saved once every update is done.
+    round_index = num_rounds;
+    saveCheckpoint();
+}
+
+bool Orchestrator::isCheckpointRound() const
+{
+    return round_index % std::max(static_cast<int>(num_rounds * checkpoint_rate), 1) == 0 && round_index > 0;
+}
+
 void Orchestrator::saveCheckpoint()
+{
+    // Save the model of the server
+    server->model->save(saveClientsCheckpoint() + "/model-server.bin");
+}
+
+std::string Orchestrator::saveClientsCheckpoint()
 {
     const std::string &path = checkpoints_path;
     spdlog::info("Saving checkpoint at round: {}.", round_index);
@@ -116,8 +241,7 @@ void Orchestrator::saveCheckpoint()
         client->model->save(round_folder + "/model-client-" + std::to_string(client->id) + ".bin");
     }
     server->updated_clients.clear();
-    // Save the model of the server
-    server->model->save(round_folder + "/model-server.bin");
+    return round_folder;
 }
 
 std::vector<std::shared_ptr<Client>> initializeClients(const std::vector<std::string> &datasets_path)
@@ -168,35 +292,21 @@ metrics::Metrics Orchestrator::evaluateClients(std::vector<std::shared_ptr<Clien
                      return ids;
                  }());
 
-    std::vector<std::thread> threads;
-    // Reserve space for threads only if threaded mode is enabled
-    if (threaded)
-        threads.reserve(clients.size());
-
     std::vector<metrics::Metrics> round_metrics(clients.size());
 
-    auto evaluate_client = [](std::shared_ptr<Client> client, metrics::Metrics *metrics, std::shared_ptr<Server> server)
-    {
-        *metrics = client->model->evaluate();
-        spdlog::debug("Client {} accuracy: {}.", client->id, metrics->accuracy);
-        server->client_metrics[client->id] = *metrics;
-    };
-
-    for (size_t i = 0; i < clients.size(); ++i)
+    auto evaluate_client = [&](size_t i)
     {
-        round_metrics[i] = metrics::Metrics();
         auto client = clients[i];
-        if (threaded)
-            threads.emplace_back(evaluate_client, client, &round_metrics[i], server);
-        else
-        {
-            round_metrics[i] = client->model->evaluate();
-            server->client_metrics[client->id] = round_metrics[i];
-        }
-    }
+        round_metrics[i] = client->evaluate();
+        spdlog::debug("Client {} accuracy: {}.", client->id, round_metrics[i].accuracy);
+        server->client_metrics[client->id] = round_metrics[i];
+    };
 
-    for (auto &thread : threads)
-        thread.join();
+    if (pool)
+        pool->parallel_for(clients.size(), evaluate_client);
+    else
+        for (size_t i = 0; i < clients.size(); ++i)
+            evaluate_client(i);
     return metrics::mean(round_metrics);
 }
 
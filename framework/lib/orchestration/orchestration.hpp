@@ -3,8 +3,10 @@
 
 #include <vector>
 #include <memory>
+#include <future>
 #include <client/client.hpp>
 #include <server/server.hpp>
+#include <worker-pool/worker-pool.hpp>
 #include <metrics.hpp>
 #include <spdlog/spdlog.h>
 
@@ -19,6 +21,13 @@ public:
 
 private:
     void saveCheckpoint();
+    // Save the models of the updated clients and return the checkpoint folder of the round
+    std::string saveClientsCheckpoint();
+    bool isCheckpointRound() const;
+    // Train a round and hand its evaluation and checkpoint to a background job, run once the previous one is done
+    void runPipelinedRound(const std::vector<std::shared_ptr<Client>> &round_clients);
+    // Let the clients train continuously on the latest server model until the server aggregated num_rounds times
+    void runAsync();
     std::vector<std::shared_ptr<Client>> sampleClients();
     metrics::Metrics evaluateClients(std::vector<std::shared_ptr<Client>> clients);
 
@@ -27,7 +36,8 @@ private:
     const std::string datasets_path;
     const std::string checkpoints_path;
     std::shared_ptr<Server> server;
-    bool threaded;
+    std::shared_ptr<WorkerPool> pool; // runs the per-client jobs in threaded mode, null otherwise
+    std::future<void> pending_round; // evaluation and checkpoint of the last pipelined round
 };
 
 #endif // ORCHESTRATION_H
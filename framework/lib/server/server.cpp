@@ -7,37 +7,54 @@
 #include <model-ff.hpp>
 #include <model-bp.hpp>
 #include <metrics-logger/metrics-logger.hpp>
-#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cmath>
 #include "server.hpp"
 
 using namespace config::training;
 
-Server::Server(const std::vector<std::shared_ptr<Client>> &clients, const std::string &global_dataset_path, bool threaded)
-    : clients(clients), max_clients(clients.size()), threaded(threaded)
+// Model of the configured type.
+static std::shared_ptr<Model> make_model()
+{
+    if (config::model_type == config::ModelType::FF)
+        return std::make_shared<ModelFF>();
+    if (config::model_type == config::ModelType::BP)
+        return std::make_shared<ModelBP>();
+    spdlog::error("Model type not supported.");
+    exit(EXIT_FAILURE);
+}
+
+Server::Server(const std::vector<std::shared_ptr<Client>> &clients, const std::string &global_dataset_path, std::shared_ptr<WorkerPool> pool)
+    : clients(clients), max_clients(clients.size()), pool(pool)
 {
     client_metrics = std::vector<metrics::Metrics>(max_clients);
+    client_rates = std::vector<double>(max_clients, 0.0);
     // Initialize server model weights with the first client model weights
-    if (config::model_type == config::ModelType::FF)
-    {
-        model = std::make_shared<ModelFF>();
-    }
-    else if (config::model_type == config::ModelType::BP)
-    {
-        model = std::make_shared<ModelBP>();
-    }
-    else
+    model = make_model();
+    model->build(global_dataset_path);
+    if (config::orchestration::pipelined_rounds || config::orchestration::async_mode)
     {
-        spdlog::error("Model type not supported.");
-        exit(EXIT_FAILURE);
+        snapshot_model = make_model();
+        snapshot_model->build(global_dataset_path);
     }
-    model->build(global_dataset_path);
-    spdlog::info("Initialized server with threaded mode: {}.", threaded ? "enabled" : "disabled");
+    spdlog::info("Initialized server with threaded mode: {}.", pool ? "enabled" : "disabled");
 }
 
 Server::Server(const std::vector<std::shared_ptr<Client>> &clients, const std::string &global_dataset_path)
-    : Server(clients, global_dataset_path, false) {}
+    : Server(clients, global_dataset_path, nullptr) {}
 
 metrics::Metrics Server::executeRound(int round_index, std::vector<std::shared_ptr<Client>> round_clients)
+{
+    trainRound(round_index, round_clients);
+
+    // Test new model
+    metrics::Metrics new_model_metrics = model->evaluate();
+    log_metrics(round_index, -1, -1, DatasetType::GLOBAL, new_model_metrics);
+    return new_model_metrics;
+}
+
+void Server::trainRound(int round_index, std::vector<std::shared_ptr<Client>> round_clients)
 {
     this->round_clients = round_clients;
     this->round_index = round_index;
@@ -67,109 +84,215 @@ metrics::Metrics Server::executeRound(int round_index, std::vector<std::shared_p
     model->set_weights(aggregate_models());
 
     spdlog::info("Server model updated with the aggregated model.");
+}
 
-    // Test new model
-    metrics::Metrics new_model_metrics = model->evaluate();
-    log_metrics(round_index, -1, -1, DatasetType::GLOBAL, new_model_metrics);
-    return new_model_metrics;
+std::shared_ptr<Model> Server::snapshot()
+{
+    if (!snapshot_model)
+    {
+        spdlog::error("Server model snapshots are only available with pipelined rounds or in asynchronous mode.");
+        exit(EXIT_FAILURE);
+    }
+    std::vector<double> buffer;
+    snapshot_model->adopt_weights(model->view_weights(buffer), model->weights_version());
+    return snapshot_model;
 }
 
 void Server::broadcast()
 {
-    std::vector<std::thread> threads;
-    // Reserve space only if threaded mode is enabled
-    if (threaded)
-        threads.reserve(round_clients.size());
-
-    // Use a shared pointer for model_weights
-    auto model_weights = std::make_shared<std::vector<double>>(model->get_weights());
+    // Every client copies the same snapshot of the server model, read in place when possible.
+    // The clients already holding this version of the server model are skipped.
+    std::vector<double> buffer;
+    const Span<const double> model_weights = model->view_weights(buffer);
+    const uint64_t model_version = model->weights_version();
+    model_size = model_weights.size();
+    std::atomic<size_t> skipped{0};
 
     // Function to set weights for a client
-    auto set_weights_for_client = [&](Client& client) {
-        client.model->set_weights(*model_weights);
+    auto set_weights_for_client = [&](size_t i) {
+        Model &client_model = *round_clients[i]->model;
+        if (client_model.weights_version() == model_version)
+            ++skipped;
+        else
+            client_model.adopt_weights(model_weights, model_version);
     };
-   
-    for (auto& client : round_clients) {
-        if (threaded) {
-            // Create a thread for each client
-            threads.emplace_back(std::thread(set_weights_for_client, std::ref(*client)));
-        } else {
-            // Set weights directly if not using threads
-            set_weights_for_client(*client);
-        }
-    }
 
-    // Join all threads if threaded
-    if (threaded) {
-        for (auto& thread : threads) {
-            thread.join();
-        }
-    }
+    if (pool)
+        pool->parallel_for(round_clients.size(), set_weights_for_client);
+    else
+        for (size_t i = 0; i < round_clients.size(); ++i)
+            set_weights_for_client(i);
 
+    if (skipped > 0)
+        spdlog::info("{} clients already held the server model version {}.", skipped.load(), model_version);
     spdlog::info("Server model broadcast completed.");
 }
 
 void Server::update_clients()
 {
-    std::vector<std::thread> threads;
-    // Reserve space only if threaded mode is enabled
-    if (threaded)
-        threads.reserve(round_clients.size());
+    // Schedule the longest updates first, so that the round does not end waiting for a large client
+    // started last while the other workers are idle.
+    double rates_sum = 0.0;
+    int measured = 0;
+    for (double rate : client_rates)
+        if (rate > 0.0)
+        {
+            rates_sum += rate;
+            ++measured;
+        }
+    const double mean_rate = measured > 0 ? rates_sum / measured : 1.0;
+    std::vector<double> costs(round_clients.size());
+    std::vector<size_t> order(round_clients.size());
+    for (size_t i = 0; i < round_clients.size(); ++i)
+        costs[i] = estimate_cost(*round_clients[i], mean_rate);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return costs[a] > costs[b]; });
+
+    // Each client is weighted by its share of the samples of the round.
+    double total_size = 0.0;
+    for (const auto &client : round_clients)
+        total_size += client->dataset_size;
+    // Twice as many shards as workers, so that a client rarely finds all of its next shards taken.
+    accumulator = std::make_unique<WeightAccumulator>(model_size, pool ? 2 * pool->size() : 1,
+                                                      config::orchestration::weight_dispersion);
 
-    for (auto &client : round_clients)
+    auto update_client = [this, &order, total_size](size_t i)
     {
-        if (threaded)
-            threads.emplace_back([&client, this]()
-                                 { 
-                                    client->update(round_index, learning_rate, batch_size, epochs); });
-        else
-            client->update(round_index, learning_rate, batch_size, epochs);
-    }
+        auto &client = round_clients[order[i]];
+        const auto start = std::chrono::steady_clock::now();
+        client->update(round_index, learning_rate, batch_size, epochs);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::vector<double> buffer;
+        accumulator->add(client->model->view_weights(buffer), client->dataset_size / total_size);
+
+        // Refine the rate of the client, the round clients are distinct so each one writes its own entry.
+        const double work = client_work(*client);
+        if (work > 0.0)
+        {
+            const double rate = seconds / work;
+            double &client_rate = client_rates[client->id];
+            client_rate = client_rate > 0.0 ? 0.5 * (client_rate + rate) : rate;
+        }
+        spdlog::debug("Client {} updated in {:.3f} s.", client->id, seconds);
+    };
 
-    if (threaded)
-        for (auto &thread : threads)
-            thread.join();
+    const auto start = std::chrono::steady_clock::now();
+    if (pool)
+        pool->parallel_for(round_clients.size(), update_client);
+    else
+        for (size_t i = 0; i < round_clients.size(); ++i)
+            update_client(i);
+    spdlog::info("Round clients updated in {:.3f} s.",
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
     spdlog::info("Done updating clients.");
 }
 
+double Server::client_work(const Client &client) const
+{
+    return static_cast<double>(client.dataset_size) * epochs * std::max<size_t>(model_size, 1);
+}
+
+double Server::estimate_cost(const Client &client, double mean_rate) const
+{
+    const double rate = client_rates[client.id] > 0.0 ? client_rates[client.id] : mean_rate;
+    return rate * client_work(client);
+}
+
 std::vector<double> Server::aggregate_models()
 {
+    // The client models were already folded in the accumulator by update_clients.
     spdlog::info("Aggregating updated clients models.");
-    std::vector<std::vector<double>> models;
-    std::vector<int> dataset_sizes;
-    for (auto &client : round_clients)
-    {
-        models.push_back(client->model->get_weights());
-        dataset_sizes.push_back(client->dataset_size);
-    }
+    if (config::orchestration::weight_dispersion)
+        spdlog::info("Weight dispersion: {}.", accumulator->dispersion());
+    std::vector<double> new_model_weights = accumulator->take_sum();
+    accumulator.reset();
+    return new_model_weights;
+}
 
-    // Compute weighted average of models
-    std::vector<double> new_model_weights(models[0].size(), 0.0);
-    int total_size = std::accumulate(dataset_sizes.begin(), dataset_sizes.end(), 0);
-    for (size_t i = 0; i < models.size(); ++i)
-    {
-        for (size_t j = 0; j < models[i].size(); ++j)
-        {
-            new_model_weights[j] += models[i][j] * (static_cast<double>(dataset_sizes[i]) / total_size);
-        }
-    }
+size_t Server::async_buffer_size() const
+{
+    if (config::orchestration::async_buffer > 0)
+        return config::orchestration::async_buffer;
+    return async_lanes;
+}
 
-    // TODO: consider removing this computation to speed up round execution
-    // Compute model standard deviation
-    std::vector<double> model_diffs;
-    for (size_t i = 0; i < models.size(); ++i)
-    {
-        double diff = 0.0;
-        for (size_t j = 0; j < models[i].size(); ++j)
-        {
-            diff += std::pow(models[i][j] - new_model_weights[j], 2);
-        }
-        model_diffs.push_back(std::sqrt(diff));
-    }
-    // Compute mean weight standard deviation
-    double mean_weight_std = std::accumulate(model_diffs.begin(), model_diffs.end(), 0.0) / model_diffs.size();
-    spdlog::info("Mean weight standard deviation: {}.", mean_weight_std);
+void Server::startAsync(size_t lanes)
+{
+    std::lock_guard<std::mutex> lock(async_mutex);
+    async_lanes = std::max<size_t>(lanes, 1);
+    spdlog::info("Asynchronous aggregations of {} updates from {} concurrent clients.", async_buffer_size(), async_lanes);
+}
 
-    return new_model_weights;
+bool Server::pullModel(const std::shared_ptr<Client> &client, std::vector<double> &weights, size_t &version)
+{
+    std::lock_guard<std::mutex> lock(async_mutex);
+    if (aggregations >= config::orchestration::num_rounds)
+        return false;
+    weights.resize(model->num_weights());
+    model->copy_weights_into(weights);
+    client->model->adopt_weights(weights, model->weights_version());
+    version = aggregations;
+    return true;
+}
+
+bool Server::pushUpdate(const std::shared_ptr<Client> &client, Span<const double> update, size_t version)
+{
+    std::unique_lock<std::mutex> lock(async_mutex);
+    const size_t num_rounds = config::orchestration::num_rounds;
+    if (aggregations >= num_rounds)
+        return false;
+
+    // Updates computed from older server models count less, as in FedBuff.
+    const size_t staleness = aggregations - version;
+    const double coefficient = client->dataset_size / std::sqrt(1.0 + staleness);
+    if (!accumulator)
+        accumulator = std::make_unique<WeightAccumulator>(update.size(), 1, config::orchestration::weight_dispersion);
+    accumulator->add(update, coefficient);
+    buffered_metrics.push_back(client->history.back());
+    client_metrics[client->id] = client->history.back();
+    updated_clients.insert(client);
+    spdlog::debug("Buffered the update of client {} with staleness {}.", client->id, staleness);
+    if (++buffered_updates < async_buffer_size())
+        return true;
+
+    // Move the server model by the weighted mean of the buffered updates.
+    if (config::orchestration::weight_dispersion)
+        spdlog::info("Update dispersion: {}.", accumulator->dispersion());
+    std::vector<double> new_model_weights = model->get_weights();
+    const double total_coefficient = accumulator->total_coefficient();
+    const std::vector<double> sum = accumulator->take_sum();
+    for (size_t j = 0; j < new_model_weights.size(); ++j)
+        new_model_weights[j] += sum[j] / total_coefficient;
+    model->set_weights(new_model_weights);
+    const uint64_t model_version = model->weights_version();
+
+    const int aggregation = static_cast<int>(aggregations++);
+    const metrics::Metrics round_avg_metrics = metrics::mean(buffered_metrics);
+    const metrics::Metrics global_avg_metrics = metrics::mean(client_metrics);
+    accumulator.reset();
+    buffered_updates = 0;
+    buffered_metrics.clear();
+    const bool running = aggregations < num_rounds;
+    spdlog::info("Server model updated with the aggregation {}.", aggregation);
+
+    // The clients keep pulling and pushing while the aggregated model is evaluated from its copy. The aggregations
+    // are evaluated in order, so that their metrics stay in order, and one at a time since they share the snapshot model.
+    lock.unlock();
+    std::unique_lock<std::mutex> evaluation_lock(evaluation_mutex);
+    evaluation_turn.wait(evaluation_lock, [&]()
+                         { return evaluated_aggregations == static_cast<size_t>(aggregation); });
+    snapshot_model->adopt_weights(new_model_weights, model_version);
+
+    metrics::Metrics new_model_metrics = snapshot_model->evaluate();
+    log_metrics(aggregation, -1, -1, DatasetType::GLOBAL, new_model_metrics);
+    log_metrics(aggregation, -3, config::training::epochs, DatasetType::LOCAL, round_avg_metrics);
+    log_metrics(aggregation, -2, -1, DatasetType::LOCAL, global_avg_metrics);
+    complete_metrics_round(aggregation);
+    spdlog::info("Aggregation {} accuracy: {}, global average accuracy: {}.", aggregation, new_model_metrics.accuracy,
+                 global_avg_metrics.accuracy);
+    ++evaluated_aggregations;
+    evaluation_turn.notify_all();
+    return running;
 }
@@ -2,20 +2,41 @@
 #define SERVER_H
 
 #include <client/client.hpp>
+#include <worker-pool/worker-pool.hpp>
+#include <weight-accumulator/weight-accumulator.hpp>
 #include <vector>
 #include <memory>
 #include <random>
 #include <numeric>
 #include <spdlog/spdlog.h>
 #include <set>
+#include <mutex>
+#include <condition_variable>
 
 class Server
 {
 public:
     Server(const std::vector<std::shared_ptr<Client>>& clients, const std::string &global_dataset_path);
-    Server(const std::vector<std::shared_ptr<Client>>& clients, const std::string &global_dataset_path, bool threaded);
+    // The clients are processed by the jobs of the pool, or sequentially if it is null.
+    Server(const std::vector<std::shared_ptr<Client>>& clients, const std::string &global_dataset_path, std::shared_ptr<WorkerPool> pool);
     // Execute a federated learning round
     metrics::Metrics executeRound(int round_index, std::vector<std::shared_ptr<Client>> round_clients);
+    // Execute the training of a federated learning round: broadcast, client updates and aggregation
+    void trainRound(int round_index, std::vector<std::shared_ptr<Client>> round_clients);
+    // Copy of the server model to evaluate or save while the next round trains, built in pipelined rounds mode.
+    // The same copy is returned every time, so it must not be in use when the next snapshot is taken.
+    std::shared_ptr<Model> snapshot();
+
+    // Asynchronous mode: the clients pull the latest server model, train and push their update when done,
+    // and the server aggregates the buffered updates every async_buffer of them.
+    // Starts the asynchronous mode with the given number of clients training at the same time.
+    void startAsync(size_t lanes);
+    // Copies the latest server model into the model of the client and into weights, and sets version to the number
+    // of aggregations so far. Returns false once num_rounds aggregations are done.
+    bool pullModel(const std::shared_ptr<Client> &client, std::vector<double> &weights, size_t &version);
+    // Buffers the update of a client, its trained weights minus the ones pulled at the given version, and aggregates
+    // the buffer once full. Returns false once num_rounds aggregations are done.
+    bool pushUpdate(const std::shared_ptr<Client> &client, Span<const double> update, size_t version);
 
     // Updated clients since the last checkpoint
     std::set<std::shared_ptr<Client>> updated_clients;
@@ -30,10 +51,33 @@ private:
     std::vector<std::shared_ptr<Client>> round_clients;
     int max_clients;
     int round_index;
-    bool threaded;
+    std::shared_ptr<WorkerPool> pool;
+    std::shared_ptr<Model> snapshot_model; // null unless the rounds are pipelined
+
+    // Number of weights of the model, set by the broadcast.
+    size_t model_size = 0;
+    // Measured seconds per unit of work of each client, 0 until the client is first updated.
+    std::vector<double> client_rates;
+    // Weighted sum of the models of the round clients, folded in as each client finishes its update.
+    std::unique_ptr<WeightAccumulator> accumulator;
+
+    std::mutex async_mutex;           // Protects the server model, the update buffer and the client metrics in asynchronous mode.
+    std::mutex evaluation_mutex;      // Protects the snapshot model and the evaluated aggregations.
+    std::condition_variable evaluation_turn; // Notified when an asynchronous aggregation is evaluated.
+    size_t evaluated_aggregations = 0; // Asynchronous aggregations evaluated, they are evaluated in order.
+    size_t aggregations = 0;          // Asynchronous aggregations done, the version of the server model.
+    size_t buffered_updates = 0;      // Updates in the accumulator since the last asynchronous aggregation.
+    size_t async_lanes = 1;           // Clients training at the same time in asynchronous mode.
+    std::vector<metrics::Metrics> buffered_metrics; // Metrics of the clients of the buffered updates.
+    // Number of updates of an asynchronous aggregation.
+    size_t async_buffer_size() const;
 
     void broadcast();
     void update_clients();
+    // Work of a client update: samples times epochs times weights.
+    double client_work(const Client &client) const;
+    // Expected duration of a client update, from its measured rate or the mean rate of the measured clients.
+    double estimate_cost(const Client &client, double mean_rate) const;
     std::vector<double> aggregate_models();
 };
 
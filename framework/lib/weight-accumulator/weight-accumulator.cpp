@@ -0,0 +1,112 @@
+#include <weight-accumulator/weight-accumulator.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+
+// Shard boundaries are multiples of a cache line of doubles, so two shards never share a line.
+static constexpr size_t SHARD_ALIGNMENT = 8;
+
+WeightAccumulator::WeightAccumulator(size_t size, size_t num_shards, bool track_dispersion)
+    : weighted_sum(size, 0.0), plain_sum(track_dispersion ? size : 0, 0.0), track_dispersion(track_dispersion)
+{
+    num_shards = std::max<size_t>(num_shards, 1);
+    size_t shard_size = (size + num_shards - 1) / num_shards;
+    shard_size = (shard_size + SHARD_ALIGNMENT - 1) / SHARD_ALIGNMENT * SHARD_ALIGNMENT;
+    for (size_t begin = 0; begin < size || shards.empty(); begin += shard_size)
+    {
+        auto shard = std::make_unique<Shard>();
+        shard->begin = begin;
+        shard->end = std::min(begin + shard_size, size);
+        shards.push_back(std::move(shard));
+    }
+}
+
+void WeightAccumulator::add(Span<const double> weights, double coefficient)
+{
+    if (weights.size() != weighted_sum.size())
+    {
+        spdlog::error("Cannot aggregate a model of {} weights into {} weights.", weights.size(), weighted_sum.size());
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t count = shards.size();
+    const size_t start = next_shard++ % count;
+    std::vector<bool> folded(count, false);
+    size_t remaining = count;
+    while (remaining > 0)
+    {
+        // Fold the free shards, then wait for the first busy one if none was free.
+        bool progress = false;
+        for (size_t k = 0; k < count; ++k)
+        {
+            const size_t s = (start + k) % count;
+            if (folded[s])
+                continue;
+            std::unique_lock<std::mutex> lock(shards[s]->mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+                continue;
+            fold(*shards[s], weights.data(), coefficient);
+            folded[s] = true;
+            --remaining;
+            progress = true;
+        }
+        if (progress)
+            continue;
+        for (size_t k = 0; k < count; ++k)
+        {
+            const size_t s = (start + k) % count;
+            if (folded[s])
+                continue;
+            std::lock_guard<std::mutex> lock(shards[s]->mutex);
+            fold(*shards[s], weights.data(), coefficient);
+            folded[s] = true;
+            --remaining;
+            break;
+        }
+    }
+    ++num_models;
+}
+
+void WeightAccumulator::fold(Shard &shard, const double *weights, double coefficient)
+{
+    // Simple loops over contiguous ranges, vectorized by the compiler into fused multiply-adds.
+    double *sum = weighted_sum.data();
+    for (size_t j = shard.begin; j < shard.end; ++j)
+        sum[j] += coefficient * weights[j];
+    shard.coefficients += coefficient;
+
+    if (!track_dispersion)
+        return;
+    double *plain = plain_sum.data();
+    double squares = 0.0;
+    for (size_t j = shard.begin; j < shard.end; ++j)
+    {
+        plain[j] += weights[j];
+        squares += weights[j] * weights[j];
+    }
+    shard.squares += squares;
+}
+
+double WeightAccumulator::dispersion() const
+{
+    const size_t n = num_models;
+    const double total = total_coefficient();
+    if (!track_dispersion || n == 0 || total == 0.0)
+        return 0.0;
+    // With the weighted mean m = weighted_sum / total:
+    // sum_i |w_i - m|^2 = sum_i |w_i|^2 - 2 m . sum_i w_i + n |m|^2
+    double squares = 0.0;
+    for (const auto &shard : shards)
+        squares += shard->squares;
+    double cross = 0.0;
+    double mean_squares = 0.0;
+    for (size_t j = 0; j < weighted_sum.size(); ++j)
+    {
+        const double mean = weighted_sum[j] / total;
+        cross += mean * plain_sum[j];
+        mean_squares += mean * mean;
+    }
+    const double distances = squares - 2.0 * cross + n * mean_squares;
+    return std::sqrt(std::max(distances, 0.0) / n);
+}
@@ -0,0 +1,60 @@
+#ifndef WEIGHT_ACCUMULATOR_HPP
+#define WEIGHT_ACCUMULATOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <model/span.hpp>
+
+// Streaming weighted sum of model weights, folded in by the clients as soon as they finish training.
+// The weights are split in shards of contiguous ranges, each with its own lock. A client folds the shards
+// starting from a different one than the other clients and skips the locked ones, coming back to them later,
+// so concurrent clients rarely wait for each other. Memory is O(weights) whatever the number of clients.
+class WeightAccumulator
+{
+public:
+    // Accumulator of size weights in num_shards shards, also tracking the dispersion of the models if requested.
+    WeightAccumulator(size_t size, size_t num_shards, bool track_dispersion);
+
+    WeightAccumulator(const WeightAccumulator &) = delete;
+    WeightAccumulator &operator=(const WeightAccumulator &) = delete;
+
+    // Adds weights * coefficient to the sum, thread safe.
+    void add(Span<const double> weights, double coefficient);
+
+    // Moves out the weighted sum, to be called once every client is added.
+    std::vector<double> take_sum() { return std::move(weighted_sum); }
+
+    // Sum of the coefficients of the added models, to be called once every client is added.
+    double total_coefficient() const { return shards.front()->coefficients; }
+
+    // Root mean square distance between the added models and their weighted mean, the weighted sum divided by
+    // the total coefficient, 0 if not tracked. To be called once every client is added, before take_sum.
+    double dispersion() const;
+
+private:
+    // Range of weights with its lock, the sum of squares of the models in the range and the sum of
+    // the coefficients of the models folded in it, the same for every shard once all of them are folded.
+    struct Shard
+    {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+        double squares = 0.0;
+        double coefficients = 0.0;
+    };
+
+    // Folds the range of a shard, with its lock held.
+    void fold(Shard &shard, const double *weights, double coefficient);
+
+    std::vector<double> weighted_sum;
+    std::vector<double> plain_sum; // Unweighted sum of the models, only if the dispersion is tracked.
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<size_t> next_shard{0}; // Shard folded first by the next client.
+    std::atomic<size_t> num_models{0};
+    const bool track_dispersion;
+};
+
+#endif // WEIGHT_ACCUMULATOR_HPP
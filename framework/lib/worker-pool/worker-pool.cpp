@@ -0,0 +1,131 @@
+#include <worker-pool/worker-pool.hpp>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+WorkerPool::WorkerPool(size_t num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < num_threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    workers.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+        workers.emplace_back(&WorkerPool::work, this, i);
+    spdlog::info("Worker pool started with {} threads.", num_threads);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    available.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+std::future<void> WorkerPool::submit(std::function<void()> job)
+{
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+    std::future<void> result = task->get_future();
+    Queue &queue = *queues[next_queue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.emplace_back([task]()
+                                { (*task)(); });
+    }
+    {
+        // Taking the mutex orders the increment with the check of a worker going to sleep.
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pending;
+    }
+    available.notify_one();
+    return result;
+}
+
+void WorkerPool::parallel_for(size_t count, const std::function<void(size_t)> &task)
+{
+    if (count == 0)
+        return;
+
+    // The tasks are claimed in order by the helpers submitted to the pool and by the calling thread.
+    struct Loop
+    {
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t completed = 0;
+        std::exception_ptr error;
+    };
+    auto loop = std::make_shared<Loop>();
+    auto run_tasks = [loop, count, &task]()
+    {
+        size_t i;
+        while ((i = loop->next++) < count)
+        {
+            std::exception_ptr error;
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            if (error && !loop->error)
+                loop->error = error;
+            if (++loop->completed == count)
+                loop->done.notify_all();
+        }
+    };
+
+    // A helper that starts after all the tasks are claimed returns at once, the task reference is not used.
+    const size_t helpers = std::min(count, workers.size());
+    for (size_t i = 0; i < helpers; ++i)
+        submit(run_tasks);
+    run_tasks();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->done.wait(lock, [&]()
+                    { return loop->completed == count; });
+    if (loop->error)
+        std::rethrow_exception(loop->error);
+}
+
+bool WorkerPool::take_job(size_t worker, std::function<void()> &job)
+{
+    // Own queue first, from the front to keep the submission order.
+    for (size_t k = 0; k < queues.size(); ++k)
+    {
+        Queue &queue = *queues[(worker + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        --pending;
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::work(size_t worker)
+{
+    std::function<void()> job;
+    while (true)
+    {
+        if (take_job(worker, job))
+        {
+            job();
+            job = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this]()
+                       { return stop || pending > 0; });
+        if (stop && pending == 0)
+            return;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads, created once and reused by every phase of every round.
+// Each worker owns a queue of jobs: it runs its own jobs in submission order and, when it runs out,
+// steals the oldest pending job of another worker.
+class WorkerPool
+{
+public:
+    // Starts num_threads workers, or one per core if num_threads is 0.
+    explicit WorkerPool(size_t num_threads = 0);
+
+    // Runs the pending jobs and stops the workers.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Number of worker threads.
+    size_t size() const { return workers.size(); }
+
+    // Submits a job, the future holds its exception if it throws.
+    std::future<void> submit(std::function<void()> job);
+
+    // Calls task(i) for every i in [0, count), in increasing order of start, and waits for all of them.
+    // The calling thread takes part, so a job of the pool may call it without deadlocking.
+    // The first exception thrown by a task is rethrown once all the tasks are done.
+    void parallel_for(size_t count, const std::function<void(size_t)> &task);
+
+private:
+    // Queue of jobs of a worker.
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    // Takes a job from the queue of a worker, or steals one from the other queues.
+    bool take_job(size_t worker, std::function<void()> &job);
+
+    // Main loop of a worker thread.
+    void work(size_t worker);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;                  // Protects the sleeping workers and stop.
+    std::condition_variable available; // Notified when a job is submitted or the pool stops.
+    std::atomic<size_t> pending{0};    // Number of submitted jobs not yet taken.
+    std::atomic<size_t> next_queue{0}; // Queue of the next submitted job, round robin.
+    bool stop = false;
+};
+
+#endif // WORKER_POOL_HPP
@@ -182,6 +182,26 @@ void parse_args(const int argc, const char *argv[])
             }
             config::orchestration::checkpoint_rate = std::stof(argv[i]);
         }
+        else if (args[i] == "--eval-threads" || args[i] == "-et")
+        {
+            i++;
+            if (args[i][0] == '-' || std::stoi(argv[i]) < 1)
+            {
+                spdlog::error("Invalid number of evaluation threads.");
+                exit(EXIT_FAILURE);
+            }
+            config::orchestration::eval_threads = std::stoi(argv[i]);
+        }
+        else if (args[i] == "--worker-threads" || args[i] == "-wt")
+        {
+            i++;
+            if (args[i][0] == '-')
+            {
+                spdlog::error("Invalid number of worker threads.");
+                exit(EXIT_FAILURE);
+            }
+            config::orchestration::worker_threads = std::stoi(argv[i]);
+        }
         else if (args[i] == "--dataset" || args[i] == "-d")
         {
             i++;
@@ -234,11 +254,63 @@ void parse_args(const int argc, const char *argv[])
         {
             config::orchestration::threaded = true;
         }
+        else if (args[i] == "--pipelined-training" || args[i] == "-pt")
+        {
+            config::training::pipelined = true;
+        }
+        else if (args[i] == "--weight-dispersion" || args[i] == "-wd")
+        {
+            config::orchestration::weight_dispersion = true;
+        }
+        else if (args[i] == "--pipelined-rounds" || args[i] == "-pr")
+        {
+            config::orchestration::pipelined_rounds = true;
+        }
+        else if (args[i] == "--async-mode" || args[i] == "-am")
+        {
+            config::orchestration::async_mode = true;
+        }
+        else if (args[i] == "--async-buffer" || args[i] == "-ab")
+        {
+            i++;
+            if (args[i][0] == '-')
+            {
+                spdlog::error("Invalid asynchronous buffer size.");
+                exit(EXIT_FAILURE);
+            }
+            config::orchestration::async_buffer = std::stoi(argv[i]);
+        }
+        else if (args[i] == "--prefetch-batches" || args[i] == "-pb")
+        {
+            i++;
+            if (args[i][0] == '-')
+            {
+                spdlog::error("Invalid number of prefetched batches.");
+                exit(EXIT_FAILURE);
+            }
+            config::training::prefetch_batches = std::stoi(argv[i]);
+        }
     }
     if (args[argc - 1] == "--threaded-mode" || args[argc - 1] == "-tm")
     {
         config::orchestration::threaded = true;
     }
+    if (args[argc - 1] == "--pipelined-training" || args[argc - 1] == "-pt")
+    {
+        config::training::pipelined = true;
+    }
+    if (args[argc - 1] == "--weight-dispersion" || args[argc - 1] == "-wd")
+    {
+        config::orchestration::weight_dispersion = true;
+    }
+    if (args[argc - 1] == "--pipelined-rounds" || args[argc - 1] == "-pr")
+    {
+        config::orchestration::pipelined_rounds = true;
+    }
+    if (args[argc - 1] == "--async-mode" || args[argc - 1] == "-am")
+    {
+        config::orchestration::async_mode = true;
+    }
 }
 
 void print_help(std::string name)
@@ -260,13 +332,21 @@ void print_help(std::string name)
               << "--learning-rate, -lr: Learning rate for the training. Default: " << config::training::learning_rate << "." << std::endl
               << "--batch-size, -bs: Batch size for the training. Default: " << config::training::batch_size << "." << std::endl
               << "--epochs, -e: Number of epochs for the training. Default: " << config::training::epochs << "." << std::endl
+              << "--pipelined-training, -pt: Train the cells of the FF model in a pipeline, one thread per cell. Default: false." << std::endl
+              << "--prefetch-batches, -pb: Number of batches generated ahead by a background thread, 0 to disable. Default: " << config::training::prefetch_batches << "." << std::endl
               << "--num-clients, -ncl: Number of clients in the simulation. Default: " << config::orchestration::num_clients << "." << std::endl
               << "--num-rounds, -nr: Number of rounds in the simulation. Default: " << config::orchestration::num_rounds << "." << std::endl
               << "--client-rate, -cr: Client rate for the simulation. Default: " << config::orchestration::c_rate << "." << std::endl
               << "--checkpoint-rate, -chr: Checkpoint rate for the simulation. Default: " << config::orchestration::checkpoint_rate << "." << std::endl
+              << "--eval-threads, -et: Number of threads used to evaluate a model. Default: " << config::orchestration::eval_threads << "." << std::endl
               << "--dataset, -d: Dataset to use (digits, mnist, emnist). Default: << " << config::selected_dataset << "." << std::endl
               << "--log-level, -ll: Log level (debug, info, warn, error). Default: info." << std::endl
-              << "--threaded-mode, -tm: Enable threaded mode for the orchestrator. Default: false." << std::endl;
+              << "--threaded-mode, -tm: Enable threaded mode for the orchestrator. Default: false." << std::endl
+              << "--worker-threads, -wt: Number of threads running the clients in threaded mode, 0 for one per core. Default: " << config::orchestration::worker_threads << "." << std::endl
+              << "--weight-dispersion, -wd: Log the dispersion of the client models around the aggregated model. Default: false." << std::endl
+              << "--pipelined-rounds, -pr: Evaluate and checkpoint each round in the background while the next round trains. Default: false." << std::endl
+              << "--async-mode, -am: Let the clients train continuously and aggregate their buffered updates weighted by staleness, --num-rounds times. Default: false." << std::endl
+              << "--async-buffer, -ab: Number of updates buffered before an asynchronous aggregation, 0 for one per concurrent client. Default: " << config::orchestration::async_buffer << "." << std::endl;
 }
 
 config::ModelType get_model_type(std::vector<std::string> args)
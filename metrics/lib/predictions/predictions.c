@@ -8,6 +8,7 @@
 #include <predictions/predictions.h>
 
 #include <stdio.h>
+#include <string.h>
 
 /**
  * @brief Initializes the predictions structure by setting the number of predictions to 0.
@@ -52,3 +53,26 @@ void add_prediction(const Label true_label, const Label predicted_label, Predict
         printf("Maximum number of predictions reached.\n");
     }
 }
+
+/**
+ * @brief Appends the predictions of another structure, keeping their order.
+ *
+ * This function is used to merge the predictions computed on separate parts of a dataset.
+ * If the maximum number of predictions is reached, the exceeding predictions are discarded.
+ *
+ * @param predictions The predictions to append to.
+ * @param other The predictions to append.
+ */
+void merge_predictions(Predictions *predictions, const Predictions *other)
+{
+    int count = other->num_predictions;
+    if (predictions->num_predictions + count > MAX_PREDICTIONS)
+    {
+        printf("Maximum number of predictions reached.\n");
+        count = MAX_PREDICTIONS - predictions->num_predictions;
+    }
+    memcpy(&predictions->true_labels[predictions->num_predictions], other->true_labels, count * sizeof(Label));
+    memcpy(&predictions->predicted_labels[predictions->num_predictions], other->predicted_labels,
+           count * sizeof(Label));
+    predictions->num_predictions += count;
+}
@@ -43,3 +43,11 @@ void reset_predictions(Predictions *predictions);
  * @param predicted_label The predicted label of the prediction.
  */
 void add_prediction(const Label true_label, const Label predicted_label, Predictions *predictions);
+
+/**
+ * @brief Appends the predictions of another structure, keeping their order.
+ *
+ * @param predictions The predictions to append to.
+ * @param other The predictions to append.
+ */
+void merge_predictions(Predictions *predictions, const Predictions *other);
@@ -1,5 +1,6 @@
 #include "model-bp.hpp"
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <config/config.hpp>
 
 void ModelBP::build(const std::string &data_path)
@@ -132,6 +133,7 @@ void ModelBP::train(const int &epochs, const int &batch_size, const double &lear
         // std::cout << std::endl
         //           << "Epoch " << epoch++ << "/" << epochs << " finished. "
         //           << epoch_time.elapsed() << "s elapsed." << std::endl;
+        bump_weights_version();
         on_enumerate_epoch();
 
         // disp.restart(train_images.size());
@@ -177,29 +179,44 @@ metrics::Metrics ModelBP::evaluate()
     return metrics;
 }
 
-std::vector<double> ModelBP::get_weights() const
+size_t ModelBP::num_weights() const
 {
-    std::vector<double> weights;
-    for (int i = 0; i < bpnet.layer_size(); i++)
+    size_t count = 0;
+    for (size_t i = 0; i < bpnet.layer_size(); i++)
+        for (const tiny_dnn::vec_t *layer_weights : bpnet[i]->weights())
+            count += layer_weights->size();
+    return count;
+}
+
+void ModelBP::copy_weights_into(Span<double> weights) const
+{
+    // The weights of tiny-dnn are owned by each layer, so they are copied one vector at a time.
+    if (weights.size() != num_weights())
     {
-        const std::vector<const tiny_dnn::vec_t *> &layer_weights = bpnet[i]->weights();
-        for (int j = 0; j < layer_weights.size(); j++)
-            for (int k = 0; k < layer_weights[j]->size(); k++)
-                weights.push_back(layer_weights[j]->at(k));
+        spdlog::error("Cannot copy {} weights into a buffer of {}.", num_weights(), weights.size());
+        exit(EXIT_FAILURE);
     }
-    return weights;
+    double *out = weights.data();
+    for (size_t i = 0; i < bpnet.layer_size(); i++)
+        for (const tiny_dnn::vec_t *layer_weights : bpnet[i]->weights())
+            out = std::copy(layer_weights->begin(), layer_weights->end(), out);
 }
 
-void ModelBP::set_weights(const std::vector<double> &weights)
+void ModelBP::assign_weights(Span<const double> weights)
 {
-    int weight_index = 0;
-    for (int i = 0; i < bpnet.layer_size(); i++)
+    if (weights.size() != num_weights())
     {
-        const std::vector<tiny_dnn::vec_t *> &layer_weights = bpnet[i]->weights();
-        for (int j = 0; j < layer_weights.size(); j++)
-            for (int k = 0; k < layer_weights[j]->size(); k++)
-                bpnet[i]->weights()[j]->at(k) = weights[weight_index++];
+        spdlog::error("Cannot assign {} weights to a model of {}.", weights.size(), num_weights());
+        exit(EXIT_FAILURE);
     }
+    const double *in = weights.data();
+    for (size_t i = 0; i < bpnet.layer_size(); i++)
+        for (tiny_dnn::vec_t *layer_weights : bpnet[i]->weights())
+        {
+            std::copy(in, in + layer_weights->size(), layer_weights->begin());
+            in += layer_weights->size();
+        }
+    bump_weights_version();
 }
 
 void ModelBP::save(const std::string filename)
@@ -210,4 +227,5 @@ void ModelBP::save(const std::string filename)
 void ModelBP::load(const std::string filename)
 {
     bpnet.load(filename);
+    bump_weights_version();
 }
\ No newline at end of file
@@ -23,11 +23,14 @@ public:
     // Evaluate the model's performance with the given test data and labels
     metrics::Metrics evaluate() override;
 
-    // Get the model's weights
-    std::vector<double> get_weights() const override;
+    // Number of weights of the model
+    size_t num_weights() const override;
 
-    // Set the model's weights
-    void set_weights(const std::vector<double> &weights) override;
+    // Copy the model's weights into a buffer of num_weights() elements
+    void copy_weights_into(Span<double> weights) const override;
+
+    // Set the model's weights from a buffer of num_weights() elements
+    void assign_weights(Span<const double> weights) override;
 
     // Save the model's weights to a file
     void save(const std::string filename) override;
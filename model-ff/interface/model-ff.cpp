@@ -5,12 +5,16 @@
 #include <filesystem>
 #include <spdlog/spdlog.h>
 #include <unordered_map>
+#include <memory>
+#include <atomic>
 
 extern "C"
 {
 #include <ff-net/ff-net.h>
 #include <logging/logging.h>
 #include <utils/utils.h>
+#include <ff-pipeline/ff-pipeline.h>
+#include <ff-prefetcher/ff-prefetcher.h>
 }
 
 #define FF_LOG_DIR "model-ff-logs"
@@ -19,6 +23,29 @@ extern "C"
 
 // TODO: add parameter layer_epochs.
 
+// Returns the thread pool used to evaluate the models, shared by all the models of the process.
+// Evaluation is serial when a single evaluation thread is configured.
+static ThreadPool *get_eval_pool()
+{
+    static std::unique_ptr<ThreadPool, decltype(&free_thread_pool)> pool(
+        config::orchestration::eval_threads > 1 ? new_thread_pool(config::orchestration::eval_threads) : nullptr,
+        free_thread_pool);
+    return pool.get();
+}
+
+// Routes the logs of the FF engine on the calling thread to the logger of a model while in scope.
+class ThreadLoggerScope
+{
+public:
+    explicit ThreadLoggerScope(Logger *logger) : previous(set_thread_logger(logger)) {}
+    ~ThreadLoggerScope() { set_thread_logger(previous); }
+    ThreadLoggerScope(const ThreadLoggerScope &) = delete;
+    ThreadLoggerScope &operator=(const ThreadLoggerScope &) = delete;
+
+private:
+    Logger *previous;
+};
+
 void ModelFF::build(const std::string &data_path)
 {
     using namespace config;
@@ -34,9 +61,9 @@ void ModelFF::build(const std::string &data_path)
     int *units_array = new int[layers_num];
     std::copy(units.begin(), units.end(), units_array);
 
+    // Every client has its own dataset, hence its own stream.
     auto seed = std::hash<std::string>{}(data_path);
-    set_seed(seed); // comment for reproducibility
-    set_log_level(LOG_INFO);
+    rng = new_rng(seed, 0);
     std::filesystem::path ff_logs_folder = basepath + logs_folder + FF_LOG_DIR;
     if (!std::filesystem::exists(ff_logs_folder))
     {
@@ -46,11 +73,14 @@ void ModelFF::build(const std::string &data_path)
             exit(EXIT_FAILURE);
         }
     }
-    open_log_file_with_timestamp(ff_logs_folder.c_str());
-    set_log_level(LOG_INFO);
+    // Every model writes its own log file, models built in the same second are told apart by their index.
+    static std::atomic<int> num_models{0};
+    const std::string log_name = "model" + std::to_string(num_models++);
+    logger.reset(new_logger(ff_logs_folder.c_str(), log_name.c_str(), LOG_INFO));
+    ThreadLoggerScope logger_scope(logger.get());
 
     // Build the model.
-    ffnet = new_ff_net(units_array, layers_num, relu, pdrelu, threshold, beta1, beta2, loss);
+    ffnet = new_ff_net(units_array, layers_num, relu, pdrelu, threshold, beta1, beta2, loss, &rng);
 
     log_info("Initializing model with the following parameters:\n");
     log_info("\tThreshold: %.2f\n", threshold);
@@ -62,7 +92,8 @@ void ModelFF::build(const std::string &data_path)
 
     // Initialize model data structure.
     spdlog::debug("Reading dataset from: {}", data_path);
-    data = dataset_split(data_path.c_str(), num_classes);
+    // The text splits are parsed by the evaluation pool, idle while the models are built.
+    data = dataset_split_parallel(data_path.c_str(), num_classes, get_eval_pool());
     // Read the input size from the dataset compare to the selected input layer size.
     const int input_size = data.train->feature_len;
     if (units[0] != input_size)
@@ -76,20 +107,29 @@ void ModelFF::build(const std::string &data_path)
 
 void ModelFF::train(const int &epochs, const int &batch_size, const double &learning_rate, std::function<void()> on_enumerate_epoch)
 {
+    ThreadLoggerScope logger_scope(logger.get());
     // Find max layer size.
     const int max_units = *std::max_element(units.begin(), units.end());
 
     // clock_t start_time = clock();
     // Since batch is used for all layers, sample size is set to the maximum of the layers sizes.
     FFBatch batch = new_ff_batch(batch_size, max_units);
+    // Two batches per cell keep every cell busy while the next batch is generated.
+    FFPipeline *pipeline = config::training::pipelined ? new_ff_pipeline(ffnet, batch_size, max_units, 2 * ffnet->num_cells)
+                                                       : nullptr;
+    FFPrefetcher *prefetcher = config::training::prefetch_batches > 0
+                                   ? new_ff_prefetcher(data.train, batch_size, max_units, config::training::prefetch_batches, &rng)
+                                   : nullptr;
 
     on_enumerate_epoch();
     for (int i = 0; i < epochs; i++) // iterate over model epochs
     {
         // clock_t epoch_start_time = clock();
-        shuffle_data(data.train);
+        shuffle_data(data.train, &rng);
         double loss = 0.0f;
         int num_batches = data.train->rows / batch_size;
+        if (prefetcher)
+            ff_prefetcher_begin_epoch(prefetcher, num_batches);
         // Print progress bar
         // init_progress_bar();
 
@@ -98,11 +138,22 @@ void ModelFF::train(const int &epochs, const int &batch_size, const double &lear
             // Update progress bar
             // update_progress_bar(j, num_batches);
 
-            generate_batch(data.train, j, batch);                            // generate positive and negative samples
-            loss += train_ff_net(ffnet, batch, learning_rate) / num_batches; // train the model
+            // generate positive and negative samples
+            FFBatch current = batch;
+            if (prefetcher)
+                current = ff_prefetcher_next(prefetcher);
+            else
+                generate_batch(data.train, j, batch, &rng);
+            if (pipeline)
+                ff_pipeline_push(pipeline, current, learning_rate);                // train the model in the pipeline
+            else
+                loss += train_ff_net(ffnet, current, learning_rate) / num_batches; // train the model
         }
+        if (pipeline)
+            loss = ff_pipeline_flush(pipeline) / num_batches;
         // finish_progress_bar();
         spdlog::debug("Training loss: {}", loss);
+        bump_weights_version();
         // int epoch_time = (clock() - epoch_start_time) / CLOCKS_PER_SEC;
         // printf("\tEpoch time: ");
         // print_elapsed_time(epoch_time);
@@ -114,47 +165,73 @@ void ModelFF::train(const int &epochs, const int &batch_size, const double &lear
     // print_elapsed_time(total_time);
     // printf("\n\n");
 
+    if (pipeline)
+        free_ff_pipeline(pipeline);
+    if (prefetcher)
+        free_ff_prefetcher(prefetcher);
     free_ff_batch(batch);
 }
 
 metrics::Metrics ModelFF::evaluate()
 {
+    ThreadLoggerScope logger_scope(logger.get());
     log_info("Testing FFNet...");
     // Create a Metrics object and generate the metrics
     metrics::Metrics metrics;
     Predictions predictions;
-    init_predictions(&predictions);
-    metrics.loss = test_ff_net(ffnet, data.test, units[0], &predictions);
+    metrics.loss = test_ff_net_parallel(ffnet, data.test, &predictions, get_eval_pool());
     metrics.generate(&predictions);
 
     return metrics;
 }
 
-std::vector<double> ModelFF::get_weights() const
+size_t ModelFF::num_weights() const
+{
+    return ffnet->num_parameters;
+}
+
+Span<const double> ModelFF::weights_view() const
 {
-    std::vector<double> weights;
-    for (int i = 0; i < ffnet->num_cells; i++)                 // iterate over cells
-        for (int j = 0; j < ffnet->layers[i].num_weights; j++) // iteratet over weights
-            weights.push_back(ffnet->layers[i].weights[j]);    // add weight to vector
-    return weights;
+    // The weights of all the cells are contiguous at the start of the arena of the FFNet.
+#ifdef FF_SINGLE_PRECISION
+    return {};
+#else
+    return {ffnet->parameters, static_cast<size_t>(ffnet->num_parameters)};
+#endif
 }
 
-void ModelFF::set_weights(const std::vector<double> &weights)
+void ModelFF::copy_weights_into(Span<double> weights) const
 {
-    int weight_index = 0;
-    for (int i = 0; i < ffnet->num_cells; i++)                     // iterate over cells
-        for (int j = 0; j < ffnet->layers[i].num_weights; j++)     // iterate over weights
-            ffnet->layers[i].weights[j] = weights[weight_index++]; // set weight from vector
+    if (weights.size() != num_weights())
+    {
+        spdlog::error("Cannot copy {} weights into a buffer of {}.", num_weights(), weights.size());
+        exit(EXIT_FAILURE);
+    }
+    std::copy(ffnet->parameters, ffnet->parameters + ffnet->num_parameters, weights.data());
+}
+
+void ModelFF::assign_weights(Span<const double> weights)
+{
+    if (weights.size() != num_weights())
+    {
+        spdlog::error("Cannot assign {} weights to a model of {}.", weights.size(), num_weights());
+        exit(EXIT_FAILURE);
+    }
+    std::copy(weights.begin(), weights.end(), ffnet->parameters);
+    bump_weights_version();
 }
 
 void ModelFF::save(const std::string filename)
 {
+    ThreadLoggerScope logger_scope(logger.get());
     save_ff_net(ffnet, filename.c_str(), false); // set checkpoint default path to false
     log_debug("FFNet saved to %s", filename.c_str());
 }
 
 void ModelFF::load(const std::string filename)
 {
+    ThreadLoggerScope logger_scope(logger.get());
     load_ff_net(ffnet, filename.c_str(), relu, pdrelu, beta1, beta2, false); // set checkpoint default path to false
+    bump_weights_version();
     log_debug("FFNet loaded from %s", filename.c_str());
 }
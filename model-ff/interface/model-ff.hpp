@@ -4,12 +4,15 @@
 #include "../../framework/lib/model/model.hpp"
 #include <vector>
 #include <random>
+#include <memory>
 #include <metrics.hpp>
 
 extern "C"
 {
 #include <ff-net/ff-net.h>
 #include <data/data.h>
+#include <rng/rng.h>
+#include <logging/logging.h>
 }
 
 
@@ -28,11 +31,17 @@ public:
     // Evaluate the model's performance with the given test data and labels
     metrics::Metrics evaluate() override;
 
-    // Get the model's weights
-    std::vector<double> get_weights() const override;
+    // Number of weights of the model
+    size_t num_weights() const override;
 
-    // Set the model's weights
-    void set_weights(const std::vector<double> &weights) override;
+    // View of the arena of the FFNet, empty with single precision weights
+    Span<const double> weights_view() const override;
+
+    // Copy the model's weights into a buffer of num_weights() elements
+    void copy_weights_into(Span<double> weights) const override;
+
+    // Set the model's weights from a buffer of num_weights() elements
+    void assign_weights(Span<const double> weights) override;
 
     // Save the model's weights to a file
     void save(const std::string filename) override;
@@ -43,6 +52,8 @@ public:
 private:
     FFNet *ffnet;
     Dataset data;
+    Rng rng; // random stream of the client: initial weights, shuffles and negative labels
+    std::unique_ptr<Logger, decltype(&free_logger)> logger{nullptr, free_logger}; // log file of the model
 
     float threshold;
     float beta1, beta2;
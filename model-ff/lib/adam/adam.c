@@ -4,64 +4,102 @@
  */
 
 #include <adam/adam.h>
-#include <math.h>
+#include <tgmath.h>
 
 /**
- * @brief Creates an Adam optimizer with the given beta1, beta2, and size.
+ * @brief Creates an Adam optimizer with the given beta1, beta2, and moment vectors.
  * 
  * @param beta1 The exponential decay rate for the first moment estimates.
  * @param beta2 The exponential decay rate for the second moment estimates.
- * @param size The size of the weight vector.
+ * @param m The zero-initialized first moment estimates.
+ * @param v The zero-initialized second moment estimates.
  * @return The created Adam optimizer.
  */
-Adam adam_create(const double beta1, const double beta2, const int size)
+Adam adam_create(const double beta1, const double beta2, Scalar *m, Scalar *v)
 {
     Adam adam;
     adam.beta1 = beta1;
     adam.beta2 = beta2;
 
-    // Initialize time step to 1
-    adam.t = 1;
+    // No update performed yet, the first step is t = 1
+    adam.t = 0;
     
-    // Allocate memory for m and v 0-initialized
-    adam.m = (double*)calloc(size, sizeof(double));
-    adam.v = (double*)calloc(size, sizeof(double));
+    // The moments live in memory owned by the caller
+    adam.m = m;
+    adam.v = v;
 
     return adam;
 }
 
 /**
- * @brief Frees the memory allocated for the Adam optimizer.
- * 
- * @param adam The Adam optimizer to free.
+ * @brief Performs one Adam optimization step over a whole weight vector.
+ *
+ * @param adam The Adam optimizer.
+ * @param weights The weights to update.
+ * @param gradient The gradient of the weights, reset to zero after the update.
+ * @param size The number of weights.
+ * @param learning_rate The learning rate of the step.
  */
-void adam_free(Adam adam)
+void adam_step(Adam *adam, Scalar *weights, Scalar *gradient, const int size, const double learning_rate)
 {
-    free(adam.m);
-    free(adam.v);
+    const AdamStep step = adam_begin_step(adam, learning_rate);
+    adam_apply_step(adam, step, weights, gradient, 0, size);
 }
 
 /**
- * @brief Updates the weight using the Adam optimizer.
- * 
+ * @brief Starts an Adam optimization step.
+ *
  * @param adam The Adam optimizer.
- * @param gradient The gradient of the weight.
- * @param index The index of the weight.
- * @return The updated weight.
+ * @param learning_rate The learning rate of the step.
+ * @return The coefficients shared by all the weights of the step.
  */
-double adam_weight_update(Adam adam, const double gradient, const int index)
+AdamStep adam_begin_step(Adam *adam, const double learning_rate)
 {
     // Increment time step
-    adam.t++;
+    adam->t++;
+
+    // Bias corrections are shared by all the weights of the step
+    AdamStep step;
+    step.learning_rate = learning_rate;
+    step.m_correction = 1.0 / (1.0 - pow(adam->beta1, adam->t));
+    step.v_correction = 1.0 / (1.0 - pow(adam->beta2, adam->t));
+    return step;
+}
+
+/**
+ * @brief Applies an Adam optimization step to a range of weights.
+ *
+ * @param adam The Adam optimizer.
+ * @param step The coefficients of the step.
+ * @param weights The weights to update.
+ * @param gradient The gradient of the weights, reset to zero after the update.
+ * @param begin The first weight of the range.
+ * @param end The end of the range (excluded).
+ */
+void adam_apply_step(const Adam *adam, const AdamStep step, Scalar *restrict weights, Scalar *restrict gradient,
+                     const int begin, const int end)
+{
+    // Hyperparameters in the precision of the weights
+    const Scalar beta1 = adam->beta1;
+    const Scalar beta2 = adam->beta2;
+    const Scalar lr = step.learning_rate;
+    const Scalar m_correction = step.m_correction;
+    const Scalar v_correction = step.v_correction;
+    const Scalar epsilon = ADAM_EPSILON;
+    Scalar *restrict m = adam->m;
+    Scalar *restrict v = adam->v;
+    for (int i = begin; i < end; i++)
+    {
+        const Scalar g = gradient[i];
 
-    // Update the Adam optimizer
-    adam.m[index] = adam.beta1 * adam.m[index] + (1 - adam.beta1) * gradient;
-    adam.v[index] = adam.beta2 * adam.v[index] + (1 - adam.beta2) * gradient * gradient;
+        // Update the moment estimates
+        m[i] = beta1 * m[i] + (1 - beta1) * g;
+        v[i] = beta2 * v[i] + (1 - beta2) * g * g;
 
-    // Bias correction
-    const double m_hat = adam.m[index] / (1 - pow(adam.beta1, adam.t));
-    const double v_hat = adam.v[index] / (1 - pow(adam.beta2, adam.t));
+        // Weight update using the bias-corrected moments
+        weights[i] -= lr * (m[i] * m_correction) / (sqrt(v[i] * v_correction) + epsilon);
 
-    // Weight update using Adam optimizer
-    return m_hat / (sqrt(v_hat) + 1e-8);
+        // Reset the gradient for the next batch
+        gradient[i] = 0.0;
+    }
 }
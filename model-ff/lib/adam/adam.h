@@ -8,6 +8,14 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <scalar/scalar.h>
+
+/**
+ * @def ADAM_EPSILON
+ * @brief Term added to the denominator of the update for numerical stability.
+ */
+#define ADAM_EPSILON 1e-8
+
 /**
  * @struct Adam
  * @brief Struct representing the Adam optimizer.
@@ -16,31 +24,67 @@ typedef struct
 {
     double beta1; /**< Adam hyperparameter: exponential decay rate for the first moment estimate */
     double beta2; /**< Adam hyperparameter: exponential decay rate for the second moment estimate */
-    double *m; /**< First moment estimate vector */
-    double *v; /**< Second moment estimate vector */
-    int t; /**< Time step */
+    Scalar *m; /**< First moment estimate vector */
+    Scalar *v; /**< Second moment estimate vector */
+    int t; /**< Time step of the last update */
 } Adam;
 
 /**
- * @brief Creates a new Adam optimizer instance.
+ * @brief Coefficients shared by all the weights updated in an Adam step.
+ */
+typedef struct
+{
+    Scalar learning_rate; /**< Learning rate of the step */
+    Scalar m_correction; /**< Bias correction of the first moment estimate */
+    Scalar v_correction; /**< Bias correction of the second moment estimate */
+} AdamStep;
+
+/**
+ * @brief Creates a new Adam optimizer instance on moment vectors owned by the caller.
  * @param beta1 The exponential decay rate for the first moment estimate.
  * @param beta2 The exponential decay rate for the second moment estimate.
- * @param size The size of the weight vector.
+ * @param m The first moment estimate vector, zero-initialized, as long as the weight vector.
+ * @param v The second moment estimate vector, zero-initialized, as long as the weight vector.
  * @return The created Adam optimizer instance.
  */
-Adam adam_create(double beta1, double beta2, int size);
+Adam adam_create(double beta1, double beta2, Scalar *m, Scalar *v);
 
 /**
- * @brief Frees the memory allocated for an Adam optimizer instance.
- * @param adam The Adam optimizer instance to be freed.
+ * @brief Performs one Adam optimization step over a whole weight vector.
+ *
+ * The time step is incremented once and the bias corrections are computed once for all the weights.
+ * The gradient is reset to zero in the same pass, ready to accumulate the next batch.
+ *
+ * @param adam The Adam optimizer instance.
+ * @param weights The weights to update.
+ * @param gradient The gradient of the weights.
+ * @param size The number of weights.
+ * @param learning_rate The learning rate of the step.
+ */
+void adam_step(Adam *adam, Scalar *weights, Scalar *gradient, const int size, const double learning_rate);
+
+/**
+ * @brief Starts an Adam optimization step, to be applied to ranges of weights with adam_apply_step.
+ *
+ * The time step is incremented and the bias corrections are computed once for all the weights.
+ *
+ * @param adam The Adam optimizer instance.
+ * @param learning_rate The learning rate of the step.
+ * @return The coefficients of the step.
  */
-void adam_free(Adam adam);
+AdamStep adam_begin_step(Adam *adam, const double learning_rate);
 
 /**
- * @brief Updates the weight using the Adam optimizer.
+ * @brief Applies an Adam optimization step to a range of weights and resets their gradient.
+ *
+ * Disjoint ranges can be updated concurrently by different threads.
+ *
  * @param adam The Adam optimizer instance.
- * @param gradient The gradient of the weight.
- * @param index The index of the weight.
- * @return The weight update value.
+ * @param step The coefficients of the step.
+ * @param weights The weights to update.
+ * @param gradient The gradient of the weights.
+ * @param begin The first weight of the range.
+ * @param end The end of the range (excluded).
  */
-double adam_weight_update(Adam adam, double gradient, int index);
+void adam_apply_step(const Adam *adam, const AdamStep step, Scalar *weights, Scalar *gradient, const int begin,
+                     const int end);
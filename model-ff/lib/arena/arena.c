@@ -0,0 +1,45 @@
+/**
+ * @file arena.c
+ * @brief Implementation of the aligned memory arenas.
+ */
+
+// posix_memalign and madvise are not part of C99.
+#define _DEFAULT_SOURCE
+
+#include <arena/arena.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <logging/logging.h>
+
+void *new_arena(const size_t size)
+{
+#ifdef FF_HUGE_PAGES
+    // Whole huge pages, so that the arena does not share them with other allocations.
+    const size_t alignment = ARENA_HUGE_PAGE_SIZE;
+#else
+    const size_t alignment = ARENA_ALIGNMENT;
+#endif
+    const size_t aligned_size = (size + alignment - 1) / alignment * alignment;
+    void *arena = NULL;
+    if (posix_memalign(&arena, alignment, aligned_size) != 0)
+    {
+        log_error("Could not allocate an arena of %zu bytes", aligned_size);
+        exit(1);
+    }
+#ifdef FF_HUGE_PAGES
+    // Only a hint: the arena is still usable if transparent huge pages are disabled.
+    if (madvise(arena, aligned_size, MADV_HUGEPAGE) != 0)
+        log_debug("Huge pages are not available for an arena of %zu bytes", aligned_size);
+#endif
+    memset(arena, 0, aligned_size);
+    log_debug("Allocated an arena of %zu bytes aligned to %zu bytes", aligned_size, alignment);
+    return arena;
+}
+
+void free_arena(void *arena)
+{
+    free(arena);
+}
@@ -0,0 +1,37 @@
+/**
+ * @file arena.h
+ * @brief Header file for the aligned memory arenas holding the state of a FFNet.
+ *
+ * An arena is a single zero-initialized allocation aligned for SIMD loads. Building with FF_HUGE_PAGES
+ * aligns it to huge pages and advises the kernel to back it with them, reducing the TLB misses of large networks.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @def ARENA_ALIGNMENT
+ * @brief Alignment in bytes of an arena, the size of a cache line and of the widest SIMD register.
+ */
+#define ARENA_ALIGNMENT 64
+
+/**
+ * @def ARENA_HUGE_PAGE_SIZE
+ * @brief Alignment in bytes of an arena backed by huge pages.
+ */
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Allocates a zero-initialized arena.
+ *
+ * @param size The size of the arena in bytes.
+ * @return The arena, to be freed with free_arena.
+ */
+void *new_arena(const size_t size);
+
+/**
+ * @brief Frees the memory of an arena.
+ *
+ * @param arena The arena to free.
+ */
+void free_arena(void *arena);
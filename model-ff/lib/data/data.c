@@ -3,12 +3,130 @@
  * @brief This file contains the implementation of data-related functions.
  */
 
+// mmap, open and access are not part of C99.
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <data/data.h>
 #include <utils/utils.h>
 #include <logging/logging.h>
 
+/**
+ * @brief Line-aligned chunk of a text split, parsed by a single task.
+ */
+typedef struct
+{
+    const char *begin; // First character of the chunk, at the start of a line.
+    const char *end;   // End of the chunk (excluded), at the start of a line or at the end of the file.
+    int first_row;     // Row of the first non-blank line of the chunk.
+    int rows;          // Number of non-blank lines of the chunk.
+} TextChunk;
+
+/**
+ * @brief Work shared by the tasks parsing a text split.
+ */
+typedef struct
+{
+    Data *data;             // Data object receiving the rows.
+    TextChunk *chunks;      // Chunks of the file, one per task.
+    const char *file_path;  // Path of the file, for the error messages.
+} TextParseJob;
+
+/**
+ * @brief Loads a split of a dataset, from its binary file if present or else from its text file.
+ *
+ * @param dataset_basepath The base path of the dataset.
+ * @param split The name of the split.
+ * @param feature_len The number of inputs of the rows, 0 to compute it from the text file.
+ * @param num_classes The number of classes in the dataset.
+ * @param pool The thread pool parsing the text file, NULL to parse it serially.
+ *
+ * @return The data object of the split.
+ */
+static Data *load_split(const char *dataset_basepath, const char *split, const int feature_len, const int num_classes,
+                        ThreadPool *pool);
+
+/**
+ * @brief Counts the non-blank lines of a chunk of a text split.
+ *
+ * @param arg The TextParseJob.
+ * @param task_index The index of the chunk.
+ */
+static void count_rows_task(void *arg, const int task_index);
+
+/**
+ * @brief Parses the non-blank lines of a chunk of a text split into their rows.
+ *
+ * @param arg The TextParseJob.
+ * @param task_index The index of the chunk.
+ */
+static void parse_rows_task(void *arg, const int task_index);
+
+/**
+ * @brief Parses a line of whitespace-separated values into a row of a data object.
+ *
+ * @param data The data object.
+ * @param line The first character of the line.
+ * @param end The end of the line (excluded).
+ * @param row The row index.
+ * @return False if the line holds less values than the inputs and targets of a row.
+ */
+static bool parse_row(Data *data, const char *line, const char *end, const int row);
+
+/**
+ * @brief Parses a decimal number, with the fast path of the exact conversions and strtod otherwise.
+ *
+ * Numbers with at most 19 significant digits whose mantissa and power of ten are exact doubles are converted
+ * with a single correctly rounded operation, giving the same result as strtod.
+ *
+ * @param cursor The first character to parse, leading spaces are skipped.
+ * @param end The end of the line (excluded).
+ * @param value The parsed value.
+ * @return The character following the number, NULL if no number was found.
+ */
+static const char *parse_scalar(const char *cursor, const char *end, Scalar *value);
+
+/**
+ * @brief Checks if a line holds only whitespace.
+ *
+ * @param line The first character of the line.
+ * @param end The end of the line (excluded).
+ * @return True if the line is blank.
+ */
+static bool is_blank_line(const char *line, const char *end);
+
+/**
+ * @brief Reads a value stored in a binary split.
+ *
+ * @param values The stored values.
+ * @param index The index of the value.
+ * @param value_size The size in bytes of the stored values.
+ *
+ * @return The value.
+ */
+static Scalar read_value(const unsigned char *values, const size_t index, const int value_size);
+
+/**
+ * @brief Writes values to a binary split.
+ *
+ * @param file The binary split.
+ * @param values The values to write.
+ * @param count The number of values.
+ * @param value_size The size in bytes of the stored values.
+ * @param scale The scale of the values stored as uint8.
+ *
+ * @return The largest absolute difference between a value and the stored one.
+ */
+static double write_values(FILE *file, const Scalar *values, const size_t count, const int value_size,
+                           const double scale);
+
 /**
  * @brief The feature length of the data.
  *
@@ -25,15 +143,16 @@ int get_feature_len(const char *file_path, const int num_classes)
         log_error("Could not open %s for feature len calculation", file_path);
         exit(EXIT_FAILURE);
     }
-    char c = fgetc(file);
+    int c = fgetc(file);
     int line_len = 1;
-    while (c != '\n')
+    while (c != '\n' && c != EOF)
     {
         if (c == ' ')
 
             line_len++;
         c = fgetc(file);
     }
+    fclose(file);
     return line_len - num_classes;
 }
 
@@ -47,16 +166,27 @@ int get_feature_len(const char *file_path, const int num_classes)
  */
 Dataset dataset_split(const char *dataset_basepath, const int num_classes)
 {
-    // Buffer to store the full path of the dataset files.
-    char full_path[256];
+    return dataset_split_parallel(dataset_basepath, num_classes, NULL);
+}
+
+/**
+ * @brief Splits the dataset into training, testing, and optional validation data, parsing the text splits
+ * with the threads of a pool.
+ *
+ * @param dataset_basepath The base path of the dataset, containing the training, testing, and optional validation data.
+ * @param num_classes The number of classes in the dataset.
+ * @param pool The thread pool, NULL to parse serially.
+ *
+ * @return The dataset structure containing the split data.
+ */
+Dataset dataset_split_parallel(const char *dataset_basepath, const int num_classes, ThreadPool *pool)
+{
     Dataset dataset;
-    sprintf(full_path, "%s/%s", dataset_basepath, DATA_TEST_SPLIT);
-    const int feature_size = get_feature_len(full_path, num_classes);
-    dataset.test = data_build(full_path, feature_size, num_classes);
-    sprintf(full_path, "%s/%s", dataset_basepath, DATA_TRAIN_SPLIT);
-    dataset.train = data_build(full_path, feature_size, num_classes);
-    sprintf(full_path, "%s/%s", dataset_basepath, DATA_VALIDATION_SPLIT);
-    dataset.validation = data_build(full_path, feature_size, num_classes),
+    // The test split gives the number of inputs of the other splits.
+    dataset.test = load_split(dataset_basepath, DATA_TEST_SPLIT, 0, num_classes, pool);
+    const int feature_size = dataset.test->feature_len;
+    dataset.train = load_split(dataset_basepath, DATA_TRAIN_SPLIT, feature_size, num_classes, pool);
+    dataset.validation = load_split(dataset_basepath, DATA_VALIDATION_SPLIT, feature_size, num_classes, pool);
 
     log_debug("Dataset train split: %d samples.", dataset.train->rows);
     log_debug("Dataset test split: %d samples.", dataset.test->rows);
@@ -70,6 +200,29 @@ Dataset dataset_split(const char *dataset_basepath, const int num_classes)
     return dataset;
 }
 
+static Data *load_split(const char *dataset_basepath, const char *split, const int feature_len, const int num_classes,
+                        ThreadPool *pool)
+{
+    // Buffer to store the full path of the dataset files.
+    char full_path[256];
+    snprintf(full_path, sizeof(full_path), "%s/%s%s", dataset_basepath, split, DATA_BINARY_EXTENSION);
+    if (access(full_path, R_OK) == 0)
+    {
+        Data *data = data_load_binary(full_path);
+        if (data->num_class != num_classes || (feature_len != 0 && data->feature_len != feature_len))
+        {
+            log_error("Binary split %s has %d features and %d classes, %d and %d expected", full_path,
+                      data->feature_len, data->num_class, feature_len, num_classes);
+            exit(EXIT_FAILURE);
+        }
+        return data;
+    }
+
+    snprintf(full_path, sizeof(full_path), "%s/%s%s", dataset_basepath, split, DATA_TEXT_EXTENSION);
+    return data_build_parallel(full_path, feature_len != 0 ? feature_len : get_feature_len(full_path, num_classes),
+                               num_classes, pool);
+}
+
 /**
  * Frees the memory allocated for the dataset.
  *
@@ -95,8 +248,15 @@ Data *new_data(const int feature_len, const int num_class, const int rows)
 {
     log_debug("Creating new Data object with %d features, %d classes, and %d rows.", feature_len, num_class, rows);
     Data *data = malloc(sizeof(Data));
-    data->input = new_matrix(rows, feature_len);
-    data->target = new_matrix(rows, num_class);
+    // Single block holding the inputs, then the targets and the order of the rows.
+    const size_t num_values = (size_t)rows * (feature_len + num_class);
+    data->input = malloc(num_values * sizeof(Scalar) + rows * sizeof(uint32_t));
+    data->target = data->input + (size_t)rows * feature_len;
+    data->order = (uint32_t *)(data->input + num_values);
+    for (int row = 0; row < rows; row++)
+        data->order[row] = row;
+    data->mapping = NULL;
+    data->mapping_size = 0;
     data->feature_len = feature_len;
     data->num_class = num_class;
     data->rows = rows;
@@ -104,7 +264,6 @@ Data *new_data(const int feature_len, const int num_class, const int rows)
     return data;
 }
 
-/// TODO: adapt to contiguous memory allocation calling free once.
 /**
  * @brief Frees a data object from the heap.
  *
@@ -113,13 +272,13 @@ Data *new_data(const int feature_len, const int num_class, const int rows)
 void free_data(Data *data)
 {
     log_debug("Freeing Data object at address %p.", (void *)data);
-    for (int row = 0; row < data->rows; row++)
+    if (data->mapping != NULL)
     {
-        free(data->input[row]);
-        free(data->target[row]);
+        munmap(data->mapping, data->mapping_size);
+        free(data->order);
     }
-    free(data->input);
-    free(data->target);
+    else
+        free(data->input);
     free(data);
 }
 
@@ -132,36 +291,110 @@ void free_data(Data *data)
  */
 void parse_data(Data *data, char *line, const int row)
 {
-    const int cols = data->feature_len + data->num_class;
-    for (int col = 0; col < cols; col++)
+    if (!parse_row(data, line, line + strlen(line), row))
+    {
+        log_error("Row %d has less than %d values", row, data->feature_len + data->num_class);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static bool parse_row(Data *data, const char *line, const char *end, const int row)
+{
+    Scalar *input = data_input(data, row);
+    Scalar *target = data_target(data, row);
+    for (int col = 0; col < data->feature_len; col++)
+        if ((line = parse_scalar(line, end, &input[col])) == NULL)
+            return false;
+    for (int col = 0; col < data->num_class; col++)
+        if ((line = parse_scalar(line, end, &target[col])) == NULL)
+            return false;
+    return true;
+}
+
+static const char *parse_scalar(const char *cursor, const char *end, Scalar *value)
+{
+    // Powers of ten exactly representable as doubles.
+    static const double powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+        cursor++;
+    if (cursor == end)
+        return NULL;
+
+    const char *start = cursor;
+    const bool negative = *cursor == '-';
+    if (*cursor == '-' || *cursor == '+')
+        cursor++;
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    bool exact = true;
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, has_digits = true)
     {
-        const double val = atof(strtok(col == 0 ? line : NULL, " "));
-        if (col < data->feature_len)
-            data->input[row][col] = val;
+        if (significant_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*cursor - '0');
+            significant_digits += mantissa != 0;
+        }
         else
-            data->target[row][col - data->feature_len] = val;
+            exact = false;
+    }
+    if (cursor < end && *cursor == '.')
+        for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, has_digits = true)
+        {
+            if (significant_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*cursor - '0');
+                significant_digits += mantissa != 0;
+                exponent--;
+            }
+            else
+                exact = false;
+        }
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+        exact = false;
+
+    const bool delimited = cursor == end || *cursor == ' ' || *cursor == '\t' || *cursor == '\r';
+    if (!has_digits || !exact || !delimited || mantissa > (1ULL << 53) || exponent < -22)
+    {
+        // Exponents, long mantissas, infinities and NaNs. The line is followed by a newline or the end of the buffer,
+        // so strtod cannot read past it.
+        char *stop;
+        const double parsed = strtod(start, &stop);
+        if (stop == start || stop > end)
+            return NULL;
+        *value = parsed;
+        return stop;
     }
+    const double parsed = exponent < 0 ? mantissa / powers_of_ten[-exponent] : (double)mantissa;
+    *value = negative ? -parsed : parsed;
+    return cursor;
+}
+
+static bool is_blank_line(const char *line, const char *end)
+{
+    for (; line < end; line++)
+        if (*line != ' ' && *line != '\t' && *line != '\r')
+            return false;
+    return true;
 }
 
 /**
- * @brief Randomly shuffles the rows of a data object.
+ * @brief Randomly shuffles the order of the rows of a data object with the Fisher-Yates algorithm.
  *
  * @param data The data object to be shuffled.
+ * @param rng The stream the permutation is drawn from.
  */
-void shuffle_data(Data *data)
+void shuffle_data(Data *data, Rng *rng)
 {
     log_debug("Shuffling data object at address %p.", (void *)data);
-    for (int a = 0; a < data->rows; a++)
+    for (int a = data->rows - 1; a > 0; a--)
     {
-        const int b = get_random() % data->rows;
-        double *ot = data->target[a];
-        double *it = data->input[a];
-        // Swap output.
-        data->target[a] = data->target[b];
-        data->target[b] = ot;
-        // Swap input.
-        data->input[a] = data->input[b];
-        data->input[b] = it;
+        const int b = rng_below(rng, a + 1);
+        const uint32_t row = data->order[a];
+        data->order[a] = data->order[b];
+        data->order[b] = row;
     }
 }
 
@@ -206,14 +439,15 @@ void free_ff_batch(FFBatch batch)
  * @param row The index of the row to generate samples from.
  * @param pos Pointer to the array where the positive sample will be stored.
  * @param neg Pointer to the array where the negative sample will be stored.
+ * @param rng The stream the label of the negative sample is drawn from.
  */
-void generate_samples(const Data *data, const int row, double *pos, double *neg)
+void generate_samples(const Data *data, const int row, Scalar *pos, Scalar *neg, Rng *rng)
 {
-    memcpy(pos, data->input[row], (data->feature_len - data->num_class) * sizeof(double));
-    memcpy(neg, data->input[row], (data->feature_len - data->num_class) * sizeof(double));
-    memcpy(&pos[data->feature_len - data->num_class], data->target[row], data->num_class * sizeof(double));
+    memcpy(pos, data_input(data, row), (data->feature_len - data->num_class) * sizeof(Scalar));
+    memcpy(neg, data_input(data, row), (data->feature_len - data->num_class) * sizeof(Scalar));
+    memcpy(&pos[data->feature_len - data->num_class], data_target(data, row), data->num_class * sizeof(Scalar));
     // Set the negative sample's label to 0.0f
-    memset(&neg[data->feature_len - data->num_class], 0, data->num_class * sizeof(double));
+    memset(&neg[data->feature_len - data->num_class], 0, data->num_class * sizeof(Scalar));
     // Find the label of the positive sample and store it in `one_pos`
     int one_pos = -1;
     for (int i = data->feature_len - data->num_class; i < data->feature_len; i++)
@@ -221,26 +455,33 @@ void generate_samples(const Data *data, const int row, double *pos, double *neg)
             // Store the index of the positive sample's label
             one_pos = i - (data->feature_len - data->num_class);
     // Generate a random label for the negative sample different from the positive sample's label
-    int step = 1 + get_random() % (data->num_class - 1);
+    int step = 1 + rng_below(rng, data->num_class - 1);
     int neg_label = (one_pos + step) % data->num_class;
     // Set the negative sample's label to 1.0f
     neg[(data->feature_len - data->num_class) + neg_label] = 1.0f;
 }
 
 /**
- * @brief Generates a batch of feedforward samples.
+ * @brief Generates a batch of feedforward samples, gathering the rows through the shuffled order.
  *
  * @param data The data object.
- * @param row The row index of the data object.
+ * @param row The index of the batch.
  * @param batch The FFBatch object to store the generated samples.
+ * @param rng The stream the labels of the negative samples are drawn from.
  */
-void generate_batch(const Data *data, const int batch_index, FFBatch batch)
+void generate_batch(const Data *data, const int batch_index, FFBatch batch, Rng *rng)
 {
     log_debug("Generating batch %d", batch_index);
     for (int i = 0; i < batch.size; i++)
     {
-        const int index = (batch_index * batch.size + i) % data->rows;
-        generate_samples(data, index, batch.pos[i], batch.neg[i]);
+        const int index = data->order[(batch_index * batch.size + i) % data->rows];
+#ifdef __GNUC__
+        // The gathered rows are not consecutive, fetch the next one while the current one is copied.
+        const int next = data->order[(batch_index * batch.size + i + 1) % data->rows];
+        __builtin_prefetch(data_input(data, next));
+        __builtin_prefetch(data_target(data, next));
+#endif
+        generate_samples(data, index, batch.pos[i], batch.neg[i], rng);
     }
 }
 
@@ -254,24 +495,309 @@ void generate_batch(const Data *data, const int batch_index, FFBatch batch)
  * @return The data object created from the file.
  */
 Data *data_build(const char *file_path, const int num_features, const int num_classes)
+{
+    return data_build_parallel(file_path, num_features, num_classes, NULL);
+}
+
+/**
+ * @brief Creates a new data object from a file, parsing line-aligned chunks of it with the threads of a pool.
+ *
+ * @param file_path The path to the file containing the data.
+ * @param num_features The number of features in the dataset.
+ * @param num_classes The number of classes in the dataset.
+ * @param pool The thread pool, NULL to parse serially.
+ *
+ * @return The data object created from the file.
+ */
+Data *data_build_parallel(const char *file_path, const int num_features, const int num_classes, ThreadPool *pool)
 {
     log_debug("Building data from %s", file_path);
-    FILE *file = fopen(file_path, "r");
+    FILE *file = fopen(file_path, "rb");
     if (file == NULL)
     {
         log_error("Could not open %s", file_path);
         Data *empty_data = new_data(num_features, num_classes, 0);
         return empty_data;
     }
-    const int rows = file_lines(file);
-    Data *data = new_data(num_features, num_classes, rows);
-    for (int row = 0; row < rows; row++)
+    // Read the whole file at once, terminated so that strtod stops at its end.
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    rewind(file);
+    char *buffer = malloc(size + 1);
+    if (size < 0 || fread(buffer, 1, size, file) != (size_t)size)
     {
-        char *line = read_line_from_file(file);
-        parse_data(data, line, row);
-        free(line);
+        log_error("Could not read %s", file_path);
+        exit(EXIT_FAILURE);
     }
+    buffer[size] = '\0';
     fclose(file);
-    log_debug("Built Data object at address: %p with %d samples", (void *)data, rows);
+
+    // Chunks start at the beginning of the line following their nominal start.
+    long num_chunks = size / DATA_PARSE_CHUNK_SIZE + 1;
+    if (num_chunks > 4 * thread_pool_size(pool))
+        num_chunks = 4 * thread_pool_size(pool);
+    TextChunk *chunks = malloc(num_chunks * sizeof(TextChunk));
+    const char *file_end = buffer + size;
+    for (long i = 0; i < num_chunks; i++)
+    {
+        const char *begin = buffer + size * i / num_chunks;
+        if (i > 0)
+        {
+            const char *newline = memchr(begin - 1, '\n', file_end - begin + 1);
+            begin = newline != NULL ? newline + 1 : file_end;
+        }
+        chunks[i].begin = begin;
+        if (i > 0)
+            chunks[i - 1].end = begin;
+    }
+    chunks[num_chunks - 1].end = file_end;
+
+    TextParseJob job = {NULL, chunks, file_path};
+    thread_pool_run(pool, num_chunks, count_rows_task, &job);
+    int rows = 0;
+    for (long i = 0; i < num_chunks; i++)
+    {
+        chunks[i].first_row = rows;
+        rows += chunks[i].rows;
+    }
+
+    job.data = new_data(num_features, num_classes, rows);
+    thread_pool_run(pool, num_chunks, parse_rows_task, &job);
+    free(chunks);
+    free(buffer);
+    log_debug("Built Data object at address: %p with %d samples in %ld chunks", (void *)job.data, rows, num_chunks);
+    return job.data;
+}
+
+static void count_rows_task(void *arg, const int task_index)
+{
+    TextChunk *chunk = &((TextParseJob *)arg)->chunks[task_index];
+    chunk->rows = 0;
+    for (const char *line = chunk->begin; line < chunk->end;)
+    {
+        const char *newline = memchr(line, '\n', chunk->end - line);
+        const char *line_end = newline != NULL ? newline : chunk->end;
+        chunk->rows += !is_blank_line(line, line_end);
+        line = line_end + 1;
+    }
+}
+
+static void parse_rows_task(void *arg, const int task_index)
+{
+    const TextParseJob *job = (const TextParseJob *)arg;
+    const TextChunk *chunk = &job->chunks[task_index];
+    int row = chunk->first_row;
+    for (const char *line = chunk->begin; line < chunk->end;)
+    {
+        const char *newline = memchr(line, '\n', chunk->end - line);
+        const char *line_end = newline != NULL ? newline : chunk->end;
+        if (!is_blank_line(line, line_end))
+        {
+            if (!parse_row(job->data, line, line_end, row))
+            {
+                log_error("Row %d of %s has less than %d values", row, job->file_path,
+                          job->data->feature_len + job->data->num_class);
+                exit(EXIT_FAILURE);
+            }
+            row++;
+        }
+        line = line_end + 1;
+    }
+}
+
+/**
+ * @brief Loads a data object from a memory mapped binary split.
+ *
+ * @param file_path The path to the binary split.
+ *
+ * @return The data object.
+ */
+Data *data_load_binary(const char *file_path)
+{
+    log_debug("Loading binary data from %s", file_path);
+    const int fd = open(file_path, O_RDONLY);
+    if (fd == -1)
+    {
+        log_error("Could not open %s", file_path);
+        exit(EXIT_FAILURE);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size < DATA_BINARY_HEADER_SIZE)
+    {
+        log_error("Could not read the header of %s", file_path);
+        exit(EXIT_FAILURE);
+    }
+    const size_t file_size = file_stat.st_size;
+    // A shared read-only mapping uses the page cache directly, without a private copy.
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        log_error("Could not map %s", file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    DataFileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    if (header.magic != DATA_BINARY_MAGIC || header.version != DATA_BINARY_VERSION)
+    {
+        log_error("%s is not a binary split of version %d", file_path, DATA_BINARY_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    const size_t num_inputs = (size_t)header.rows * header.feature_len;
+    const size_t num_targets = (size_t)header.rows * header.num_class;
+    if ((header.value_size != 1 && header.value_size != sizeof(float) && header.value_size != sizeof(double)) ||
+        header.rows < 0 || file_size != DATA_BINARY_HEADER_SIZE + (num_inputs + num_targets) * header.value_size)
+    {
+        log_error("Invalid header in %s", file_path);
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char *values = (const unsigned char *)mapping + DATA_BINARY_HEADER_SIZE;
+
+    if (header.value_size == sizeof(Scalar))
+    {
+        // The rows are read in place, only the order of the rows is allocated.
+        Data *data = malloc(sizeof(Data));
+        data->input = (Scalar *)values;
+        data->target = data->input + num_inputs;
+        data->order = malloc(header.rows * sizeof(uint32_t));
+        for (int row = 0; row < header.rows; row++)
+            data->order[row] = row;
+        data->mapping = mapping;
+        data->mapping_size = file_size;
+        data->feature_len = header.feature_len;
+        data->num_class = header.num_class;
+        data->rows = header.rows;
+        log_debug("Mapped Data object at address: %p with %d samples", (void *)data, data->rows);
+        return data;
+    }
+
+    Data *data = new_data(header.feature_len, header.num_class, header.rows);
+    const double scale = header.value_size == 1 ? header.scale : 1.0;
+    for (size_t i = 0; i < num_inputs; i++)
+        data->input[i] = read_value(values, i, header.value_size) * scale;
+    for (size_t i = 0; i < num_targets; i++)
+        data->target[i] = read_value(values, num_inputs + i, header.value_size);
+    munmap(mapping, file_size);
+    log_debug("Converted Data object at address: %p with %d samples", (void *)data, data->rows);
     return data;
 }
+
+/**
+ * @brief Saves a data object to a binary split.
+ *
+ * @param data The data object to save.
+ * @param file_path The path of the binary split.
+ * @param value_size The size in bytes of the stored values.
+ * @return The largest error on the stored inputs.
+ */
+double data_save_binary(const Data *data, const char *file_path, const int value_size)
+{
+    log_debug("Saving binary data to %s", file_path);
+    if (value_size != 1 && value_size != sizeof(float) && value_size != sizeof(double))
+    {
+        log_error("Invalid value size %d for %s", value_size, file_path);
+        exit(EXIT_FAILURE);
+    }
+    const size_t num_inputs = (size_t)data->rows * data->feature_len;
+    const size_t num_targets = (size_t)data->rows * data->num_class;
+
+    DataFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DATA_BINARY_MAGIC;
+    header.version = DATA_BINARY_VERSION;
+    header.rows = data->rows;
+    header.feature_len = data->feature_len;
+    header.num_class = data->num_class;
+    header.value_size = value_size;
+    header.scale = 1.0;
+    if (value_size == 1)
+    {
+        // The largest input is mapped to 255.
+        Scalar max_input = 0;
+        for (size_t i = 0; i < num_inputs; i++)
+        {
+            if (data->input[i] < 0)
+            {
+                log_error("Negative inputs of %s cannot be stored as uint8", file_path);
+                exit(EXIT_FAILURE);
+            }
+            if (data->input[i] > max_input)
+                max_input = data->input[i];
+        }
+        for (size_t i = 0; i < num_targets; i++)
+            if (data->target[i] != 0 && data->target[i] != 1)
+            {
+                log_error("Targets of %s are not one-hot and cannot be stored as uint8", file_path);
+                exit(EXIT_FAILURE);
+            }
+        if (max_input > 0)
+            header.scale = max_input / UINT8_MAX;
+    }
+
+    FILE *file = fopen(file_path, "wb");
+    if (file == NULL)
+    {
+        log_error("Could not open %s for writing", file_path);
+        exit(EXIT_FAILURE);
+    }
+    unsigned char header_bytes[DATA_BINARY_HEADER_SIZE] = {0};
+    memcpy(header_bytes, &header, sizeof(header));
+    fwrite(header_bytes, 1, sizeof(header_bytes), file);
+    const double input_error = write_values(file, data->input, num_inputs, value_size, header.scale);
+    write_values(file, data->target, num_targets, value_size, 1.0);
+    if (fclose(file) != 0)
+    {
+        log_error("Could not write %s", file_path);
+        exit(EXIT_FAILURE);
+    }
+    log_info("Saved %d samples to %s with %d-byte values, largest input error %g", data->rows, file_path, value_size,
+             input_error);
+    return input_error;
+}
+
+static Scalar read_value(const unsigned char *values, const size_t index, const int value_size)
+{
+    if (value_size == 1)
+        return values[index];
+    if (value_size == sizeof(float))
+    {
+        float value;
+        memcpy(&value, &values[index * sizeof(float)], sizeof(float));
+        return value;
+    }
+    double value;
+    memcpy(&value, &values[index * sizeof(double)], sizeof(double));
+    return value;
+}
+
+static double write_values(FILE *file, const Scalar *values, const size_t count, const int value_size,
+                           const double scale)
+{
+    double max_error = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double stored = values[i];
+        if (value_size == 1)
+        {
+            const long quantized = lround(values[i] / scale);
+            const uint8_t value = quantized > UINT8_MAX ? UINT8_MAX : quantized;
+            fwrite(&value, sizeof(value), 1, file);
+            stored = value * scale;
+        }
+        else if (value_size == sizeof(float))
+        {
+            const float value = values[i];
+            fwrite(&value, sizeof(value), 1, file);
+            stored = value;
+        }
+        else
+        {
+            const double value = values[i];
+            fwrite(&value, sizeof(value), 1, file);
+        }
+        if (fabs(stored - values[i]) > max_error)
+            max_error = fabs(stored - values[i]);
+    }
+    return max_error;
+}
@@ -12,23 +12,69 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+
+#include <scalar/scalar.h>
+#include <thread-pool/thread-pool.h>
+#include <rng/rng.h>
 
 
 // Each dataset must have a folder with the dataset name containing the following files:
 // - train.txt: the training data split.
 // - test.txt: the testing data split.
 // - validation.txt: the validation data split (optional).
-#define DATA_TRAIN_SPLIT "train.txt"
-#define DATA_TEST_SPLIT "test.txt"
-#define DATA_VALIDATION_SPLIT "validation.txt"
+// A split converted to the binary format (train.bin, test.bin, validation.bin) is loaded instead of the text one.
+#define DATA_TRAIN_SPLIT "train"
+#define DATA_TEST_SPLIT "test"
+#define DATA_VALIDATION_SPLIT "validation"
+#define DATA_TEXT_EXTENSION ".txt"
+#define DATA_BINARY_EXTENSION ".bin"
+
+// Binary splits start with this magic number, followed by the rest of the DataFileHeader.
+#define DATA_BINARY_MAGIC 0x46464453
+
+// Version of the binary format.
+#define DATA_BINARY_VERSION 1
+
+// Minimum size in bytes of the chunks of a text split parsed by the threads of a pool.
+#define DATA_PARSE_CHUNK_SIZE (256 * 1024)
+
+// Size in bytes reserved for the header of the binary splits, the rows start aligned after it.
+#define DATA_BINARY_HEADER_SIZE 64
+
+// Header of a binary split, followed by the inputs (rows x feature_len, row-major) and the targets
+// (rows x num_class, row-major), both stored with values of value_size bytes.
+typedef struct
+{
+    // DATA_BINARY_MAGIC.
+    uint32_t magic;
+    // DATA_BINARY_VERSION.
+    uint32_t version;
+    // Number of rows.
+    int32_t rows;
+    // Number of inputs of each row.
+    int32_t feature_len;
+    // Number of targets of each row.
+    int32_t num_class;
+    // Size in bytes of the stored values: 1 (uint8), 4 (float) or 8 (double).
+    int32_t value_size;
+    // Scale of the uint8 inputs: input = value * scale. The uint8 targets are not scaled.
+    double scale;
+} DataFileHeader;
 
 // Data object.
 typedef struct
 {
-    // 2D floating point array of input.
-    double **input;
-    // 2D floating point array of target.
-    double **target;
+    // Floating point array of input (rows x feature_len, row-major).
+    Scalar *input;
+    // Floating point array of target (rows x num_class, row-major).
+    Scalar *target;
+    // Permutation of the rows giving the order in which they are visited for training.
+    uint32_t *order;
+    // Memory mapped binary split holding the input and target, which are then read-only, NULL if they are owned by the Data.
+    void *mapping;
+    // Size in bytes of the mapping.
+    size_t mapping_size;
     // Number of inputs to neural network.
     int feature_len;
     // Number of outputs to neural network.
@@ -41,13 +87,37 @@ typedef struct
 typedef struct
 {
     // 2D floating point array of FF positive sample <input, correct_label>
-    double **pos;
+    Scalar **pos;
     // 2D floating point array of FF negative sample <input, incorrect_label>
-    double **neg;
+    Scalar **neg;
     // Number of samples in the batch.
     int size;
 } FFBatch;
 
+/**
+ * @brief Returns the input of a row of a data object.
+ *
+ * @param data The data object.
+ * @param row The row index, in storage order.
+ * @return The input of the row (feature_len values).
+ */
+static inline Scalar *data_input(const Data *data, const int row)
+{
+    return &data->input[(size_t)row * data->feature_len];
+}
+
+/**
+ * @brief Returns the target of a row of a data object.
+ *
+ * @param data The data object.
+ * @param row The row index, in storage order.
+ * @return The target of the row (num_class values).
+ */
+static inline Scalar *data_target(const Data *data, const int row)
+{
+    return &data->target[(size_t)row * data->num_class];
+}
+
 /**
  * @brief Creates a new data object.
  *
@@ -77,6 +147,55 @@ void free_data(Data *data);
  */
 Data *data_build(const char *file_path, const int num_features, const int num_classes);
 
+/**
+ * @brief Creates a new data object from a file, parsing it with the threads of a pool.
+ *
+ * The file is read at once and split into line-aligned chunks, each parsed by a thread directly
+ * into the rows of the data object. Blank lines are skipped.
+ *
+ * @param file_path The path to the file containing the data.
+ * @param num_features The number of features in the dataset.
+ * @param num_classes The number of classes in the dataset.
+ * @param pool The thread pool, NULL to parse serially.
+ *
+ * @return The data object created from the file.
+ */
+Data *data_build_parallel(const char *file_path, const int num_features, const int num_classes, ThreadPool *pool);
+
+/**
+ * @brief Computes the number of inputs of the rows of a text split.
+ *
+ * @param file_path The path to the text split.
+ * @param num_classes The number of classes in the dataset.
+ *
+ * @return The number of inputs of each row.
+ */
+int get_feature_len(const char *file_path, const int num_classes);
+
+/**
+ * @brief Loads a data object from a binary split.
+ *
+ * The file is memory mapped: when its values have the size of a Scalar, the data object reads them directly
+ * from the mapping, so loading is immediate and the pages are shared by all the processes using the split.
+ * Otherwise they are converted to Scalar once.
+ *
+ * @param file_path The path to the binary split.
+ *
+ * @return The data object.
+ */
+Data *data_load_binary(const char *file_path);
+
+/**
+ * @brief Saves a data object to a binary split.
+ *
+ * @param data The data object to save.
+ * @param file_path The path of the binary split.
+ * @param value_size The size in bytes of the stored values: 1 to quantize them to uint8, 4 for float, 8 for double.
+ *                   Quantization requires non-negative inputs and one-hot targets.
+ * @return The largest absolute difference between an input and the stored one.
+ */
+double data_save_binary(const Data *data, const char *file_path, const int value_size);
+
 /**
  * @brief Parses a line from a file into a data object.
  *
@@ -87,11 +206,12 @@ Data *data_build(const char *file_path, const int num_features, const int num_cl
 void parse_data(Data *data, char *line, const int row);
 
 /**
- * @brief Shuffles the data object.
+ * @brief Shuffles the order in which the rows of a data object are visited, the rows are not moved.
  *
  * @param data The data object to shuffle.
+ * @param rng The stream the permutation is drawn from.
  */
-void shuffle_data(Data *data);
+void shuffle_data(Data *data, Rng *rng);
 
 /**
  * @brief Creates a new batch of feedforward samples.
@@ -116,17 +236,19 @@ void free_ff_batch(const FFBatch batch);
  * @param row The row index of the data object.
  * @param pos The positive sample.
  * @param neg The negative sample.
+ * @param rng The stream the label of the negative sample is drawn from.
  */
-void generate_samples(const Data *data, const int row, double *pos, double *neg);
+void generate_samples(const Data *data, const int row, Scalar *pos, Scalar *neg, Rng *rng);
 
 /**
- * @brief Generates a batch of feedforward samples.
+ * @brief Generates a batch of feedforward samples from the rows of a data object in shuffled order.
  *
  * @param data The data object.
- * @param row The row index of the data object.
+ * @param row The index of the batch.
  * @param batch The FFBatch object to store the generated samples.
+ * @param rng The stream the labels of the negative samples are drawn from.
  */
-void generate_batch(const Data *data, const int row, FFBatch batch);
+void generate_batch(const Data *data, const int row, FFBatch batch, Rng *rng);
 
 /**
  * @brief Structure representing a dataset.
@@ -150,6 +272,17 @@ typedef struct
  */
 Dataset dataset_split(const char *dataset_basepath, const int num_classes);
 
+/**
+ * @brief Splits the dataset like dataset_split, parsing the text splits with the threads of a pool.
+ *
+ * @param dataset_basepath The base path of the dataset, containing the training, testing, and optional validation data.
+ * @param num_classes The number of classes in the dataset.
+ * @param pool The thread pool, NULL to parse serially.
+ *
+ * @return The dataset structure containing the split data.
+ */
+Dataset dataset_split_parallel(const char *dataset_basepath, const int num_classes, ThreadPool *pool);
+
 /**
  * @brief Frees the memory allocated for the dataset.
  *
@@ -23,36 +23,112 @@
  *
  * @param ffcell The FFCell object representing the FF cell.
  * @param in The input data for the forward pass.
+ * @param out The output activations of the forward pass.
  */
-void fprop_ff_cell(const FFCell ffcell, const double *const in);
+void fprop_ff_cell(const FFCell ffcell, const Scalar *const in, Scalar *const out);
 
 /**
- * Performs the backward pass for a feedforward (FF) cell.
+ * @brief Work shared by the tasks training a FFCell, each task owning a range of its outputs.
+ */
+typedef struct
+{
+    FFCell *ffcell;       // Trained FFCell.
+    FFBatch batch;        // Batch of positive and negative inputs.
+    Scalar *pos_output;   // Positive activations (batch.size x output_size).
+    Scalar *neg_output;   // Negative activations (batch.size x output_size).
+    Scalar *pos_delta;    // Partial derivatives of the loss with respect to the positive activations.
+    Scalar *neg_delta;    // Partial derivatives of the loss with respect to the negative activations.
+    Scalar *pos_pdloss;   // Partial derivative of the loss with respect to each positive goodness.
+    Scalar *neg_pdloss;   // Partial derivative of the loss with respect to each negative goodness.
+    AdamStep step;        // Coefficients of the Adam step.
+    int range_size;       // Number of outputs of each task, a multiple of 4.
+} FFTrainWork;
+
+/**
+ * Performs the forward pass of the outputs of a task.
+ *
+ * @param arg The FFTrainWork.
+ * @param task_index The index of the task.
+ */
+static void fprop_task(void *arg, const int task_index);
+
+/**
+ * Performs the backward pass of the outputs of a task: computes their deltas and gradient rows
+ * and applies the Adam step to their weights.
  *
- * @param ffcell The FF cell to perform the backward pass on.
- * @param learning_rate The learning rate for the cell.
+ * @param arg The FFTrainWork.
+ * @param task_index The index of the task.
  */
-static void bprop(const FFCell ffcell, const double learning_rate);
+static void bprop_task(void *arg, const int task_index);
 
 /**
- * Computes the gradient for the given of a sample of the batch for the FF cell and stores it in the gradient array.
+ * Accumulates the gradient of a batch for the FF cell in the gradient array.
+ *
+ * The gradient is computed as the rank-k update dW += Dpos^T * Xpos + Dneg^T * Xneg, where D holds the partial
+ * derivatives of the loss with respect to the activations and X the inputs of the batch.
  *
  * @param ffcell The FFCell for which the gradient is computed.
- * @param in_pos The positive input values.
- * @param in_neg The negative input values.
- * @param positive_output_buffer The positive output buffer.
- * @param g_pos The positive goodness value.
- * @param g_neg The negative goodness value.
- * @param threshold The threshold value.
- * @param loss_suite The loss function suite to be used.
+ * @param batch The batch of positive and negative inputs.
+ * @param pos_delta The partial derivatives of the loss with respect to the positive activations (batch.size x output_size).
+ * @param neg_delta The partial derivatives of the loss with respect to the negative activations (batch.size x output_size).
+ * @param begin The first output whose gradient rows are computed.
+ * @param end The end of the output range (excluded).
  */
-static void compute_gradient(const FFCell ffcell, const double *const in_pos, const double *const in_neg,
-                             const double *const positive_output_buffer, const double g_pos, const double g_neg,
-                             const double threshold, const Loss loss_suite);
+static void compute_gradient(const FFCell ffcell, const FFBatch batch, const Scalar *const pos_delta,
+                             const Scalar *const neg_delta, const int begin, const int end);
+
+/**
+ * Accumulates the outer product of up to 4 deltas and a slice of an input sample into consecutive gradient rows.
+ *
+ * @param gradient The first gradient row.
+ * @param input_size The length of a gradient row.
+ * @param rows The number of gradient rows to update (at most 4).
+ * @param delta The deltas of the gradient rows.
+ * @param in The input sample.
+ * @param begin The first input of the slice.
+ * @param end The end of the slice (excluded).
+ */
+static void accumulate_outer_product(Scalar *const gradient, const int input_size, const int rows,
+                                     const Scalar *const delta, const Scalar *const in, const int begin, const int end);
+
+/**
+ * Computes the activations of a range of outputs and their goodness for a set of samples with a blocked
+ * matrix-matrix product.
+ *
+ * @param ffcell The FFCell.
+ * @param in The input samples.
+ * @param rows The number of input samples.
+ * @param begin The first output of the range.
+ * @param end The end of the output range (excluded).
+ * @param out The output matrix (rows x output_size, row-major), only the columns of the range are written.
+ * @param goodnesses The goodness of each sample over the output range, NULL if not needed.
+ */
+static void fprop_block(const FFCell ffcell, Scalar *const *const in, const int rows, const int begin, const int end,
+                        Scalar *const out, Scalar *const goodnesses);
+
+/**
+ * Reads floating point values from a file, converting them if they were saved with a different precision.
+ *
+ * @param file The file to read the values from.
+ * @param scalar_size The size in bytes of the saved values: sizeof(float) or sizeof(double).
+ * @param values The values read.
+ * @param count The number of values to read.
+ * @return The number of values read.
+ */
+static size_t read_scalars(FILE *file, const int scalar_size, Scalar *values, const int count);
 
 // Random number generation for weights.
-static void wbrand(FFCell *ffcell);
-static double frand(void);
+static void wbrand(FFCell *ffcell, Rng *rng);
+
+/**
+ * @brief Logs the mean and standard deviation of the weights of a FFCell.
+ *
+ * @param ffcell The FFCell.
+ */
+static void log_weight_stats(const FFCell *ffcell);
+
+// Number of training steps of a cell between two weight statistics reports, 0 if disabled.
+static int stats_interval = 0;
 
 /**
  * Constructs a FF cell with the specified number of inputs, number of outputs, activation function,
@@ -64,26 +140,31 @@ static double frand(void);
  * @param pdact The derivative of the activation function for the FF cell.
  * @param beta1 The beta1 parameter for the Adam optimizer.
  * @param beta2 The beta2 parameter for the Adam optimizer.
+ * @param memory The zero-initialized memory of the weights, gradient and Adam moments.
+ * @param stride The distance between the weights, the gradient and the Adam moments.
+ * @param rng The stream the weights are drawn from, NULL to leave them zero.
  * @return The constructed FF cell.
  */
-FFCell new_ff_cell(const int input_size, const int output_size, double (*act)(double),
-                   double (*pdact)(double), const double beta1, const double beta2)
+FFCell new_ff_cell(const int input_size, const int output_size, Scalar (*act)(Scalar),
+                   Scalar (*pdact)(Scalar), const double beta1, const double beta2, Scalar *memory, const long stride,
+                   Rng *rng)
 {
     FFCell ffcell;
     ffcell.num_weights = input_size * output_size; // total number of weights
 
+    ffcell.weights = memory;             // weights
+    ffcell.gradient = memory + stride;   // gradient of each weight
     // Adam optimizer
-    ffcell.adam = adam_create(beta1, beta2, ffcell.num_weights);
+    ffcell.adam = adam_create(beta1, beta2, memory + 2 * stride, memory + 3 * stride);
 
-    ffcell.weights = (double *)calloc(ffcell.num_weights, sizeof(*ffcell.weights));   // weights
-    ffcell.output = (double *)calloc(output_size, sizeof(*ffcell.output));            // output neurons
-    ffcell.gradient = (double *)calloc(ffcell.num_weights, sizeof(*ffcell.gradient)); // gradient of each weight
     ffcell.input_size = input_size;
     ffcell.output_size = output_size;
     ffcell.act = act;
     ffcell.pdact = pdact;
     // Randomize weights and bias.
-    wbrand(&ffcell);
+    ffcell.bias = 0;
+    if (rng)
+        wbrand(&ffcell, rng);
     // Log the construction of the FF cell.
     increase_indent();
     log_debug("FFCell built with %d inputs, %d outputs, and %d weights", input_size, output_size, ffcell.num_weights);
@@ -91,15 +172,6 @@ FFCell new_ff_cell(const int input_size, const int output_size, double (*act)(do
     return ffcell;
 }
 
-// Frees object from heap.
-void free_ff_cell(const FFCell ffcell)
-{
-    free(ffcell.weights);
-    free(ffcell.output);
-    free(ffcell.gradient);
-    adam_free(ffcell.adam);
-}
-
 /**
  * @brief Trains a FFCell by performing forward and backward pass with a given a batch of data.
  * @param ffcell The FFCell to be trained.
@@ -109,169 +181,298 @@ void free_ff_cell(const FFCell ffcell)
  * @param loss_suite The loss function suite.
  * @return The loss value after training.
  */
-double train_ff_cell(const FFCell ffcell, FFBatch batch, const double learning_rate, const double threshold, const LossType loss)
+double train_ff_cell(FFCell *ffcell, FFBatch batch, const double learning_rate, const double threshold, const LossType loss)
+{
+    return train_ff_cell_parallel(ffcell, batch, learning_rate, threshold, loss, NULL);
+}
+
+double train_ff_cell_parallel(FFCell *ffcell, FFBatch batch, const double learning_rate, const double threshold,
+                              const LossType loss, ThreadPool *pool)
 {
     Loss loss_suite = select_loss(loss);
 
     // Increase the indent level for logging
     increase_indent();
-    double g_pos = 0.0, g_neg = 0.0;
     double loss_value = 0.0;
 
-    double *positive_output_buffer = malloc(ffcell.output_size * sizeof(*positive_output_buffer));
+    // Single buffer for the activations and deltas of the positive and negative samples of the batch,
+    // and the partial derivatives of the loss with respect to their goodness.
+    const int output_len = batch.size * ffcell->output_size;
+    Scalar *buffer = malloc((4 * output_len + 2 * batch.size) * sizeof(*buffer));
+    FFTrainWork work;
+    work.ffcell = ffcell;
+    work.batch = batch;
+    work.pos_output = buffer;
+    work.neg_output = work.pos_output + output_len;
+    work.pos_delta = work.neg_output + output_len;
+    work.neg_delta = work.pos_delta + output_len;
+    work.pos_pdloss = work.neg_delta + output_len;
+    work.neg_pdloss = work.pos_pdloss + batch.size;
+
+    // Each task owns a range of outputs, that is a block of weight rows, so the tasks never write the same memory.
+    // The ranges are aligned to the 4 rows of the register blocks.
+    const int num_blocks = (ffcell->output_size + 3) / 4;
+    int num_tasks = thread_pool_size(pool) < num_blocks ? thread_pool_size(pool) : num_blocks;
+    work.range_size = 4 * ((num_blocks + num_tasks - 1) / num_tasks);
+    num_tasks = (ffcell->output_size + work.range_size - 1) / work.range_size;
+
+    // Positive and negative forward pass of the whole batch.
+    thread_pool_run(pool, num_tasks, fprop_task, &work);
 
     for (int i = 0; i < batch.size; i++)
     {
-        // Get the positive and negative samples from the batch
-        double *pos = batch.pos[i];
-        double *neg = batch.neg[i];
+        // The goodness is summed over all the outputs in order, so it does not depend on the number of tasks.
+        const Scalar pos_goodness = goodness(&work.pos_output[i * ffcell->output_size], ffcell->output_size);
+        const Scalar neg_goodness = goodness(&work.neg_output[i * ffcell->output_size], ffcell->output_size);
 
-        // Positive forward pass.
-        fprop_ff_cell(ffcell, pos);
-        // Copy positive activation output.
-        memcpy(positive_output_buffer, ffcell.output, ffcell.output_size * sizeof(*ffcell.output));
-        // Calculate the goodness of the positive pass.
-        g_pos = goodness(ffcell.output, ffcell.output_size);
+        // Calculate the partial derivative of the loss with respect to the goodness of the positive and negative pass,
+        // scaled by the batch size to obtain the mean gradient of the batch.
+        work.pos_pdloss[i] = loss_suite.pdloss_pos(pos_goodness, neg_goodness, threshold) / batch.size;
+        work.neg_pdloss[i] = loss_suite.pdloss_neg(pos_goodness, neg_goodness, threshold) / batch.size;
 
-        // Negative forward pass.
-        fprop_ff_cell(ffcell, neg);
-        // Calculate the goodness of the negative pass.
-        g_neg = goodness(ffcell.output, ffcell.output_size);
+        loss_value += loss_suite.loss(pos_goodness, neg_goodness, threshold);
+    }
 
-        // Compute and accumulate the gradient of the loss function with respect to the weights.
-        compute_gradient(ffcell, pos, neg, positive_output_buffer, g_pos, g_neg, threshold, loss_suite);
+    // Compute the gradient and update the weights with a single Adam step.
+    log_debug("Performing backward pass for FFCell with %d inputs and %d outputs", ffcell->input_size, ffcell->output_size);
+    work.step = adam_begin_step(&ffcell->adam, learning_rate);
+    thread_pool_run(pool, num_tasks, bprop_task, &work);
+    log_debug("Adam step %d applied to %d weights", ffcell->adam.t, ffcell->num_weights);
 
-        // Copy the positive and negative activation output for normalization.
-        memcpy(pos, positive_output_buffer, ffcell.output_size * sizeof(*positive_output_buffer));
-        memcpy(neg, ffcell.output, ffcell.output_size * sizeof(*ffcell.output));
+    // Copy the positive and negative activation output for normalization once the inputs are no longer needed.
+    for (int i = 0; i < batch.size; i++)
+    {
+        memcpy(batch.pos[i], &work.pos_output[i * ffcell->output_size], ffcell->output_size * sizeof(*buffer));
+        memcpy(batch.neg[i], &work.neg_output[i * ffcell->output_size], ffcell->output_size * sizeof(*buffer));
 
         // Normalize the output in order to feed it to the next layer.
-        normalize_vector(pos, ffcell.output_size);
-        normalize_vector(neg, ffcell.output_size);
-
-        loss_value += loss_suite.loss(g_pos, g_neg, threshold);
+        normalize_vector(batch.pos[i], ffcell->output_size);
+        normalize_vector(batch.neg[i], ffcell->output_size);
     }
 
-    // Compute mean gradient of the batch.
-    for (int i = 0; i < ffcell.num_weights; i++)
-        ffcell.gradient[i] /= batch.size;
-    // Performs weight update.
-    bprop(ffcell, learning_rate);
-
-    // Calculate the average and standard deviation of weight values for debugging.
-    double sum_weights = 0.0;
-    double sum_weights_squared = 0.0;
-    for (int i = 0; i < ffcell.num_weights; i++)
-    {
-        sum_weights += ffcell.weights[i];
-        sum_weights_squared += ffcell.weights[i] * ffcell.weights[i];
-    }
-    double mean_weights = sum_weights / ffcell.num_weights;
-    double std_weights = sqrt((sum_weights_squared / ffcell.num_weights) - (mean_weights * mean_weights));
     decrease_indent();
-    log_info("Mean weight value: %f\n", mean_weights);
-    log_info("Standard deviation of weight value: %f\n", std_weights);
+    // Sampled weight statistics for debugging.
+    if (stats_interval > 0 && ffcell->adam.t % stats_interval == 0)
+        log_weight_stats(ffcell);
 
-    // Free the positive output buffer.
-    free(positive_output_buffer);
+    // Free the activations buffer.
+    free(buffer);
 
     // Return the loss of the layer
     return loss_value / batch.size;
 }
 
 // Performs forward propagation.
-void fprop_ff_cell(const FFCell ffcell, const double *const in)
+void fprop_ff_cell(const FFCell ffcell, const Scalar *const in, Scalar *const out)
 {
-    double debug_sum = 0.0;
+    Scalar debug_sum = 0.0;
     log_debug("Computing forward propagation for FFCell with %d inputs and %d outputs", ffcell.input_size, ffcell.output_size);
     // Calculate the activation output for each output unit
     for (int i = 0; i < ffcell.output_size; i++)
     {
-        double sum = 0.0;
+        Scalar sum = 0.0;
         // Calculate the weighted sum of the inputs
         for (int j = 0; j < ffcell.input_size; j++)
             sum += in[j] * ffcell.weights[i * ffcell.input_size + j];
         // Store the output of the activation function
-        ffcell.output[i] = ffcell.act(sum + ffcell.bias);
-        debug_sum += ffcell.output[i]; // for debugging
+        out[i] = ffcell.act(sum + ffcell.bias);
+        debug_sum += out[i]; // for debugging
     }
     log_debug("Overall activation output: %f", debug_sum);
 }
 
-static void compute_gradient(const FFCell ffcell, const double *const in_pos, const double *const in_neg,
-                             const double *const positive_output_buffer, const double g_pos, const double g_neg,
-                             const double threshold, const Loss loss_suite)
+// Performs forward propagation of a batch.
+void fprop_ff_cell_batch(const FFCell ffcell, const FFBatch batch, Scalar *pos_output, Scalar *neg_output,
+                         Scalar *pos_goodness, Scalar *neg_goodness)
 {
-    log_debug("Computing gradient for FFCell with %d inputs and %d outputs", ffcell.input_size, ffcell.output_size);
-    // Calculate the partial derivative of the loss with respect to the goodness of the positive and negative pass.
-    const double pdloss_pos = loss_suite.pdloss_pos(g_pos, g_neg, threshold);
-    const double pdloss_neg = loss_suite.pdloss_neg(g_pos, g_neg, threshold);
-    log_debug("G_pos: %f, G_neg: %f", g_pos, g_neg);
-    log_debug("Loss: %.17g", loss_suite.loss(g_pos, g_neg, threshold));
-    log_debug("Partial derivative of the loss with resect to the goodness pos: %.17g, neg: %.17g", pdloss_pos, pdloss_neg);
-
-    /// TODO: change loops to i < ffcell.num_weights
-    for (int i = 0; i < ffcell.input_size; i++)
+    log_debug("Computing batch forward propagation for FFCell with %d inputs, %d outputs and %d samples",
+              ffcell.input_size, ffcell.output_size, batch.size);
+    fprop_block(ffcell, batch.pos, batch.size, 0, ffcell.output_size, pos_output, pos_goodness);
+    fprop_block(ffcell, batch.neg, batch.size, 0, ffcell.output_size, neg_output, neg_goodness);
+}
+
+// Performs forward propagation of all the label embeddings of an input.
+void fprop_ff_cell_labels(const FFCell ffcell, const Scalar *const in, const int num_classes, Scalar *outputs,
+                          Scalar *goodnesses)
+{
+    log_debug("Computing forward propagation of %d labels for FFCell with %d inputs and %d outputs", num_classes,
+              ffcell.input_size, ffcell.output_size);
+    const int prefix_size = ffcell.input_size - num_classes;
+    for (int c = 0; c < num_classes; c++)
+        goodnesses[c] = 0.0;
+
+    for (int j = 0; j < ffcell.output_size; j++)
     {
-        for (int j = 0; j < ffcell.output_size; j++)
+        const Scalar *weights = &ffcell.weights[j * ffcell.input_size];
+        // Pre-activation of the features shared by all the label embeddings.
+        Scalar sum = ffcell.bias;
+        for (int i = 0; i < prefix_size; i++)
+            sum += in[i] * weights[i];
+        // The one-hot label selects a single weight column.
+        for (int c = 0; c < num_classes; c++)
         {
-            int weight_index = j * ffcell.input_size + i;
-
-            // Calculate the gradient of the loss with respect to the weight for the positive and negative pass
-            double gradient_pos = pdloss_pos * 2.0 * positive_output_buffer[j] * in_pos[i];
-            double gradient_neg = pdloss_neg * 2.0 * ffcell.output[j] * in_neg[i];
-            ffcell.gradient[weight_index] += gradient_pos + gradient_neg; // accumulate the gradient
+            const Scalar z = ffcell.act(sum + weights[prefix_size + c]);
+            outputs[c * ffcell.output_size + j] = z;
+            goodnesses[c] += z * z;
         }
     }
 }
 
-// Performs backward pass for the FF algorithm.
-static void bprop(const FFCell ffcell, const double learning_rate)
+static void fprop_block(const FFCell ffcell, Scalar *const *const in, const int rows, const int begin, const int end,
+                        Scalar *const out, Scalar *const goodnesses)
 {
-    log_debug("Performing backward pass for FFCell with %d inputs and %d outputs", ffcell.input_size, ffcell.output_size);
-    // Debugging variables statistics about weight updates.
-    int updated_weights = 0;
-    double sum_weight_update = 0.0;
-    double sum_weight_update_squared = 0.0;
-
-    // Update the weights for each connection between input and output units
-
-    /// TODO: change loops to i < ffcell.num_weights
-    for (int i = 0; i < ffcell.input_size; i++)
+    const int input_size = ffcell.input_size;
+    const int output_size = ffcell.output_size;
+    // The ReLU activation is inlined in the epilogue, other activations go through the function pointer.
+    const int fused_relu = ffcell.act == relu;
+    // Number of weight rows reused across the whole batch while they are hot in cache.
+    int tile_rows = FPROP_TILE_BYTES / (input_size * (int)sizeof(*ffcell.weights));
+    tile_rows = tile_rows < 4 ? 4 : tile_rows - tile_rows % 4;
+
+    if (goodnesses != NULL)
+        for (int b = 0; b < rows; b++)
+            goodnesses[b] = 0.0;
+
+    for (int tile = begin; tile < end; tile += tile_rows)
     {
-        for (int j = 0; j < ffcell.output_size; j++)
+        const int tile_end = tile + tile_rows < end ? tile + tile_rows : end;
+        for (int b0 = 0; b0 < rows; b0 += 4)
         {
-            int weight_index = j * ffcell.input_size + i;
+            // Samples past the end of the batch alias the last one and their results are discarded.
+            const Scalar *x[4];
+            for (int r = 0; r < 4; r++)
+                x[r] = in[b0 + r < rows ? b0 + r : rows - 1];
 
-            // Weight update using Adam optimizer
-            const double weight_update = learning_rate * adam_weight_update(ffcell.adam, ffcell.gradient[weight_index], weight_index);
+            for (int j0 = tile; j0 < tile_end; j0 += 4)
+            {
+                // Same for the weight rows past the end of the tile.
+                const Scalar *w[4];
+                for (int c = 0; c < 4; c++)
+                    w[c] = &ffcell.weights[(j0 + c < tile_end ? j0 + c : tile_end - 1) * input_size];
+
+                // 4x4 register block of dot products.
+                Scalar acc[4][4] = {{0}};
+                for (int k = 0; k < input_size; k++)
+                {
+                    const Scalar x0 = x[0][k], x1 = x[1][k], x2 = x[2][k], x3 = x[3][k];
+                    for (int c = 0; c < 4; c++)
+                    {
+                        const Scalar wk = w[c][k];
+                        acc[0][c] += x0 * wk;
+                        acc[1][c] += x1 * wk;
+                        acc[2][c] += x2 * wk;
+                        acc[3][c] += x3 * wk;
+                    }
+                }
+
+                // Epilogue: bias, activation and goodness.
+                for (int r = 0; r < 4 && b0 + r < rows; r++)
+                {
+                    Scalar *row = &out[(b0 + r) * output_size];
+                    for (int c = 0; c < 4 && j0 + c < tile_end; c++)
+                    {
+                        const Scalar h = acc[r][c] + ffcell.bias;
+                        const Scalar z = fused_relu ? (h > 0 ? h : 0) : ffcell.act(h);
+                        row[j0 + c] = z;
+                        if (goodnesses != NULL)
+                            goodnesses[b0 + r] += z * z;
+                    }
+                }
+            }
+        }
+    }
+}
 
-            // Update the weight
-            ffcell.weights[weight_index] -= weight_update;
-            // log_debug("Weight update: %.17g", weight_update);
-            // log_debug("Weight after correction: %.17g", ffcell.weights[j * ffcell.input_size + i]);
+static void compute_gradient(const FFCell ffcell, const FFBatch batch, const Scalar *const pos_delta,
+                             const Scalar *const neg_delta, const int begin, const int end)
+{
+    log_debug("Computing gradient for FFCell with %d inputs, %d outputs and %d samples", ffcell.input_size,
+              ffcell.output_size, batch.size);
+    const int input_size = ffcell.input_size;
+    const int output_size = ffcell.output_size;
 
-            // Update statistics about weight updates.
-            if (weight_update != 0.0)
+    // Blocks of 4 gradient rows are updated tile by tile, so that the tile stays in cache across the whole batch.
+    for (int j0 = begin; j0 < end; j0 += 4)
+    {
+        const int rows = end - j0 < 4 ? end - j0 : 4;
+        Scalar *gradient = &ffcell.gradient[j0 * input_size];
+        for (int tile = 0; tile < input_size; tile += GRADIENT_TILE_SIZE)
+        {
+            const int tile_end = tile + GRADIENT_TILE_SIZE < input_size ? tile + GRADIENT_TILE_SIZE : input_size;
+            for (int b = 0; b < batch.size; b++)
             {
-                updated_weights++;
-                sum_weight_update += weight_update;
-                sum_weight_update_squared += weight_update * weight_update;
+                accumulate_outer_product(gradient, input_size, rows, &pos_delta[b * output_size + j0], batch.pos[b], tile, tile_end);
+                accumulate_outer_product(gradient, input_size, rows, &neg_delta[b * output_size + j0], batch.neg[b], tile, tile_end);
             }
         }
     }
+}
 
-    // Log statistics about weight updates.
-    double mean_weight_update = 0.0;
-    double std_weight_update = 0.0;
-    if (updated_weights != 0)
+static void accumulate_outer_product(Scalar *const gradient, const int input_size, const int rows,
+                                     const Scalar *const delta, const Scalar *const in, const int begin, const int end)
+{
+    if (rows == 4)
+    {
+        const Scalar d0 = delta[0], d1 = delta[1], d2 = delta[2], d3 = delta[3];
+        // Inactive ReLU units have null deltas and give no contribution.
+        if (d0 == 0.0 && d1 == 0.0 && d2 == 0.0 && d3 == 0.0)
+            return;
+        Scalar *restrict g0 = gradient;
+        Scalar *restrict g1 = g0 + input_size;
+        Scalar *restrict g2 = g1 + input_size;
+        Scalar *restrict g3 = g2 + input_size;
+        for (int i = begin; i < end; i++)
+        {
+            const Scalar x = in[i];
+            g0[i] += d0 * x;
+            g1[i] += d1 * x;
+            g2[i] += d2 * x;
+            g3[i] += d3 * x;
+        }
+        return;
+    }
+    // Remainder rows at the end of the output layer.
+    for (int r = 0; r < rows; r++)
     {
-        mean_weight_update = sum_weight_update / updated_weights;
-        std_weight_update = sqrt((sum_weight_update_squared / updated_weights) - (mean_weight_update * mean_weight_update));
+        if (delta[r] == 0.0)
+            continue;
+        Scalar *restrict g = &gradient[r * input_size];
+        for (int i = begin; i < end; i++)
+            g[i] += delta[r] * in[i];
     }
-    log_debug("Updated weights: %d\n", updated_weights);
-    log_debug("Mean weight update: %f\n", mean_weight_update);
-    log_debug("Standard deviation of weight update: %f\n", std_weight_update);
+}
+
+static void fprop_task(void *arg, const int task_index)
+{
+    const FFTrainWork *work = (const FFTrainWork *)arg;
+    const int begin = task_index * work->range_size;
+    const int end = begin + work->range_size < work->ffcell->output_size ? begin + work->range_size
+                                                                          : work->ffcell->output_size;
+    fprop_block(*work->ffcell, work->batch.pos, work->batch.size, begin, end, work->pos_output, NULL);
+    fprop_block(*work->ffcell, work->batch.neg, work->batch.size, begin, end, work->neg_output, NULL);
+}
+
+static void bprop_task(void *arg, const int task_index)
+{
+    const FFTrainWork *work = (const FFTrainWork *)arg;
+    FFCell *ffcell = work->ffcell;
+    const int output_size = ffcell->output_size;
+    const int begin = task_index * work->range_size;
+    const int end = begin + work->range_size < output_size ? begin + work->range_size : output_size;
+
+    // Chain the partial derivative of the loss with respect to the goodness with the partial derivative
+    // of the goodness with respect to each activation.
+    for (int i = 0; i < work->batch.size; i++)
+        for (int j = begin; j < end; j++)
+        {
+            work->pos_delta[i * output_size + j] = work->pos_pdloss[i] * 2 * work->pos_output[i * output_size + j];
+            work->neg_delta[i * output_size + j] = work->neg_pdloss[i] * 2 * work->neg_output[i * output_size + j];
+        }
+
+    // Accumulate the gradient rows of the outputs and update their weights, which also resets the gradient.
+    compute_gradient(*ffcell, work->batch, work->pos_delta, work->neg_delta, begin, end);
+    adam_apply_step(&ffcell->adam, work->step, ffcell->weights, ffcell->gradient, begin * ffcell->input_size,
+                    end * ffcell->input_size);
 }
 
 /**
@@ -295,17 +496,27 @@ void save_ff_cell(const FFCell ffcell, FILE *file)
     fwrite(&ffcell.bias, sizeof(ffcell.bias), 1, file);
 }
 
+static size_t read_scalars(FILE *file, const int scalar_size, Scalar *values, const int count)
+{
+    if (scalar_size == sizeof(Scalar))
+        return fread(values, sizeof(Scalar), count, file);
+
+    void *saved = malloc((size_t)count * scalar_size);
+    const size_t res = fread(saved, scalar_size, count, file);
+    for (size_t i = 0; i < res; i++)
+        values[i] = scalar_size == sizeof(float) ? (Scalar)((float *)saved)[i] : (Scalar)((double *)saved)[i];
+    free(saved);
+    return res;
+}
+
 /**
- * Loads an FFCell object from a file.
+ * Loads the weights of an FFCell object from a file.
  *
+ * @param ffcell The FFCell built with the input and output size saved in the file.
  * @param file The file to read the FFCell object from.
- * @param act Pointer to the activation function.
- * @param pdact Pointer to the derivative of the activation function.
- * @param beta1 The beta1 parameter for the FFCell object.
- * @param beta2 The beta2 parameter for the FFCell object.
- * @return The loaded FFCell object.
+ * @param scalar_size The size in bytes of the saved weights, converted to Scalar if different.
  */
-FFCell load_ff_cell(FILE *file, double (*act)(double), double (*pdact)(double), const double beta1, const double beta2)
+void load_ff_cell(FFCell *ffcell, FILE *file, const int scalar_size)
 {
     // Read input and output size from file.
     int input_size = 0;
@@ -323,52 +534,69 @@ FFCell load_ff_cell(FILE *file, double (*act)(double), double (*pdact)(double),
         log_error("Failed to read output size from file");
         exit(1);
     }
+    if (input_size != ffcell->input_size || output_size != ffcell->output_size)
+    {
+        log_error("FFCell size mismatch: %d x %d in file, %d x %d expected", input_size, output_size,
+                  ffcell->input_size, ffcell->output_size);
+        exit(1);
+    }
 
     log_debug("Loading FFCell with %d inputs and %d outputs", input_size, output_size);
 
-    // Allocate memory to create FFCell object.
-    FFCell ffcell = new_ff_cell(input_size, output_size, act, pdact, beta1, beta2);
-
     // Load weights and bias from the file.
-    res = fread(ffcell.weights, sizeof(*ffcell.weights), ffcell.num_weights, file);
-    if (res != (size_t)ffcell.num_weights)
+    res = read_scalars(file, scalar_size, ffcell->weights, ffcell->num_weights);
+    if (res != (size_t)ffcell->num_weights)
     {
         log_error("Failed to read weights from file");
         exit(1);
     }
-    res = fread(&ffcell.bias, sizeof(ffcell.bias), 1, file);
+    res = read_scalars(file, scalar_size, &ffcell->bias, 1);
     if (res != 1)
     {
         log_error("Failed to read bias from file");
         exit(1);
     }
 
-    log_debug("FFCell loaded with %d inputs, %d outputs, and %d weights", ffcell.input_size, ffcell.output_size, ffcell.num_weights);
-    return ffcell;
+    log_debug("FFCell loaded with %d inputs, %d outputs, and %d weights", ffcell->input_size, ffcell->output_size, ffcell->num_weights);
 }
 
 // ReLU activation function.
-double relu(const double a)
+Scalar relu(const Scalar a)
 {
-    return a > 0.0 ? a : 0.0;
+    return a > 0 ? a : 0;
 }
 
 // ReLU derivative.
-double pdrelu(const double a)
+Scalar pdrelu(const Scalar a)
 {
-    return a > 0.0 ? 1.0 : 0.0;
+    return a > 0 ? 1 : 0;
 }
 
-// Randomizes weights and bias.
-static void wbrand(FFCell *ffcell)
+void set_ff_cell_stats_interval(const int interval)
+{
+    stats_interval = interval;
+}
+
+static void log_weight_stats(const FFCell *ffcell)
 {
+    // Calculate the average and standard deviation of weight values.
+    double sum_weights = 0.0;
+    double sum_weights_squared = 0.0;
     for (int i = 0; i < ffcell->num_weights; i++)
-        ffcell->weights[i] = frand() - 0.5;
-    ffcell->bias = frand() - 0.5;
+    {
+        sum_weights += ffcell->weights[i];
+        sum_weights_squared += ffcell->weights[i] * ffcell->weights[i];
+    }
+    double mean_weights = sum_weights / ffcell->num_weights;
+    double std_weights = sqrt((sum_weights_squared / ffcell->num_weights) - (mean_weights * mean_weights));
+    log_info("Mean weight value after step %d: %f", ffcell->adam.t, mean_weights);
+    log_info("Standard deviation of weight value after step %d: %f", ffcell->adam.t, std_weights);
 }
 
-// Returns random double in [0.0 - 1.0]
-static double frand(void)
+// Randomizes weights and bias.
+static void wbrand(FFCell *ffcell, Rng *rng)
 {
-    return get_random() / (double)RAND_MAX;
+    for (int i = 0; i < ffcell->num_weights; i++)
+        ffcell->weights[i] = rng_uniform(rng) - 0.5;
+    ffcell->bias = rng_uniform(rng) - 0.5;
 }
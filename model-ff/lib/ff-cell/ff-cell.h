@@ -9,12 +9,8 @@
 #include <data/data.h>
 #include <adam/adam.h>
 #include <losses/losses.h>
-
-/**
- * @def H_BUFFER_SIZE
- * @brief Size of buffer to store output activations.
- */
-#define H_BUFFER_SIZE 1024
+#include <thread-pool/thread-pool.h>
+#include <rng/rng.h>
 
 /**
  * @def MAX_CLASSES
@@ -22,21 +18,32 @@
  */
 #define MAX_CLASSES 16
 
+/**
+ * @def FPROP_TILE_BYTES
+ * @brief Size in bytes of the tile of weight rows kept hot in cache by the batched forward pass.
+ */
+#define FPROP_TILE_BYTES (128 * 1024)
+
+/**
+ * @def GRADIENT_TILE_SIZE
+ * @brief Number of inputs of the gradient rows updated together by the rank-k gradient accumulation.
+ */
+#define GRADIENT_TILE_SIZE 512
+
 /**
  * @struct FFCell
- * @brief FFCell struct that contains the weights, bias, and output layer.
+ * @brief FFCell struct that contains the weights, bias, and optimizer state.
  */
 typedef struct
 {
-    double *weights;               /**< All the weights. */
-    double bias;                   /**< Biases. */
-    double *output;                /**< Output layer. */
-    double *gradient;              /**< Gradient of each weight for a batch. */
+    Scalar *weights;               /**< All the weights, in the arena of the FFNet. */
+    Scalar bias;                   /**< Biases. */
+    Scalar *gradient;              /**< Gradient of each weight for a batch, in the arena of the FFNet. */
     int num_weights;               /**< Number of weights. */
     int input_size;                /**< Number of inputs. */
     int output_size;               /**< Number of outputs. */
-    double (*act)(const double);   /**< Activation function. */
-    double (*pdact)(const double); /**< Derivative of activation function. */
+    Scalar (*act)(const Scalar);   /**< Activation function. */
+    Scalar (*pdact)(const Scalar); /**< Derivative of activation function. */
     Adam adam;                     /**< Adam optimizer. */
 } FFCell;
 
@@ -49,35 +56,98 @@ typedef struct
  * @param output_size The number of outputs.
  * @param act The activation function.
  * @param pdact The derivative of the activation function.
+ * The FFCell does not own its memory: its weights, gradient and Adam moments are laid out in the zero-initialized
+ * memory provided by the caller, each one a stride after the previous, and live as long as that memory.
+ *
+ * @param input_size The number of inputs.
+ * @param output_size The number of outputs.
+ * @param act The activation function.
+ * @param pdact The derivative of the activation function.
  * @param beta1 The hyperparameter for the FF algorithm.
  * @param beta2 The hyperparameter for the FF algorithm.
+ * @param memory The memory of the weights, followed by the gradient, the first and the second Adam moments.
+ * @param stride The distance between the weights, the gradient and the Adam moments, at least input_size * output_size.
+ * @param rng The stream the weights are drawn from, NULL to leave them zero, as when they are loaded afterwards.
  * @return The newly generated FFCell.
  */
-FFCell new_ff_cell(const int input_size, const int output_size, double (*act)(double), double (*pdact)(double), const double beta1, const double beta2);
+FFCell new_ff_cell(const int input_size, const int output_size, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
+                   const double beta1, const double beta2, Scalar *memory, const long stride, Rng *rng);
 
 /**
- * @brief Frees the memory of a FFCell.
- * @param ffcell The FFCell to be freed.
+ * @brief Trains a FFCell by performing forward and backward pass with a given a batch of data.
+ * @param ffcell The FFCell to be trained.
+ * @param batch The batch of data to train on.
+ * @param learning_rate The learning rate for the training.
+ * @param threshold The threshold value for the FFCell.
+ * @param loss_suite The loss function suite.
+ * @return The loss value after training.
  */
-void free_ff_cell(FFCell ffcell);
+double train_ff_cell(FFCell *ffcell, FFBatch batch, const double learning_rate, const double threshold, const LossType loss_suite);
 
 /**
- * @brief Trains a FFCell by performing forward and backward pass with a given a batch of data.
+ * @brief Trains a FFCell like train_ff_cell, splitting its outputs across the threads of a pool.
+ *
+ * Each thread computes the activations, the gradient rows and the weight update of a range of outputs,
+ * so the trained weights are the same for any number of threads.
+ *
  * @param ffcell The FFCell to be trained.
  * @param batch The batch of data to train on.
  * @param learning_rate The learning rate for the training.
  * @param threshold The threshold value for the FFCell.
  * @param loss_suite The loss function suite.
+ * @param pool The thread pool, NULL to train serially.
  * @return The loss value after training.
  */
-double train_ff_cell(const FFCell ffcell, FFBatch batch, const double learning_rate, const double threshold, const LossType loss_suite);
+double train_ff_cell_parallel(FFCell *ffcell, FFBatch batch, const double learning_rate, const double threshold,
+                              const LossType loss_suite, ThreadPool *pool);
+
+/**
+ * @brief Sets how often the training logs the mean and standard deviation of the weights of a cell.
+ *
+ * The statistics read every weight of the cell, so they are disabled by default.
+ *
+ * @param interval The number of training steps of a cell between two reports, 0 to disable them.
+ */
+void set_ff_cell_stats_interval(const int interval);
 
 /**
  * @brief Performs the forward pass for a FFCell.
  * @param ffcell The FFCell.
  * @param in The input values.
+ * @param out The output activations.
+ */
+void fprop_ff_cell(const FFCell ffcell, const Scalar *const in, Scalar *const out);
+
+/**
+ * @brief Performs the forward pass for a whole batch of positive and negative samples.
+ *
+ * The activations are computed as a cache-blocked matrix-matrix product between the batch and the weights,
+ * with bias, activation function and goodness fused in the kernel epilogue.
+ *
+ * @param ffcell The FFCell.
+ * @param batch The batch of positive and negative samples.
+ * @param pos_output The output matrix of the positive samples (batch.size x output_size, row-major).
+ * @param neg_output The output matrix of the negative samples (batch.size x output_size, row-major).
+ * @param pos_goodness The goodness of each positive sample (batch.size).
+ * @param neg_goodness The goodness of each negative sample (batch.size).
+ */
+void fprop_ff_cell_batch(const FFCell ffcell, const FFBatch batch, Scalar *pos_output, Scalar *neg_output,
+                         Scalar *pos_goodness, Scalar *neg_goodness);
+
+/**
+ * @brief Performs the forward pass of a FFCell for every label embedded in the same input.
+ *
+ * The label embeddings of an input differ only in their last num_classes entries, so the pre-activation of the
+ * shared feature prefix is computed once and each label only adds its own weight column.
+ *
+ * @param ffcell The FFCell.
+ * @param in The input values, whose last num_classes entries are ignored.
+ * @param num_classes The number of classes.
+ * @param outputs The output of each label embedding (num_classes x output_size, row-major).
+ * @param goodnesses The goodness of each label embedding (num_classes).
  */
-void fprop_ff_cell(const FFCell ffcell, const double *const in);
+void fprop_ff_cell_labels(const FFCell ffcell, const Scalar *const in, const int num_classes, Scalar *outputs,
+                          Scalar *goodnesses);
 
 /**
  * Saves the FFCell to a file.
@@ -90,32 +160,27 @@ void fprop_ff_cell(const FFCell ffcell, const double *const in);
 void save_ff_cell(const FFCell ffcell, FILE *file);
 
 /**
- * Loads a feedforward cell from a file.
+ * Loads the weights of a feedforward cell from a file.
  *
  * This function reads the parameters of a feedforward cell from the given file
- * and returns a loaded FFCell structure. The activation function and its
- * derivative are passed as function pointers. The beta1 and beta2 parameters
- * are used for some internal calculations.
+ * into an FFCell built with the same input and output size.
  *
+ * @param ffcell The FFCell to load the weights and bias into.
  * @param file   The file to read the cell parameters from.
- * @param act    The activation function pointer.
- * @param pdact  The derivative of the activation function pointer.
- * @param beta1  The beta1 parameter for internal calculations.
- * @param beta2  The beta2 parameter for internal calculations.
- * @return       The loaded FFCell structure.
+ * @param scalar_size The size in bytes of the saved weights, converted if different from sizeof(Scalar).
  */
-FFCell load_ff_cell(FILE *file, double (*act)(double), double (*pdact)(double), const double beta1, const double beta2);
+void load_ff_cell(FFCell *ffcell, FILE *file, const int scalar_size);
 
 /**
  * @brief Activation function: Rectified Linear Unit (ReLU).
  * @param a The input value.
  * @return The output value after applying the ReLU activation function.
  */
-double relu(const double a);
+Scalar relu(const Scalar a);
 
 /**
  * @brief Derivative of the ReLU activation function.
  * @param a The input value.
  * @return The derivative of the ReLU activation function at the given input value.
  */
-double pdrelu(const double a);
+Scalar pdrelu(const Scalar a);
@@ -20,9 +20,21 @@
 #include <ff-cell/ff-cell.h>
 #include <ff-utils/ff-utils.h>
 #include <metrics.h>
+#include <arena/arena.h>
 #include <assert.h>
 
-int parse_label(const double *target, const int num_classes);
+int parse_label(const Scalar *target, const int num_classes);
+
+static void build_ff_cells(FFNet *ffnet, const int *layer_sizes, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
+                           const double beta1, const double beta2, Scalar *arena, Rng *rng);
+
+static bool has_ff_layout(const FFNet *ffnet, const int num_cells, const int *layer_sizes);
+
+static double test_ff_net_rows(const FFNet *ffnet, FFInferenceContext *context, const Data *data, const int begin,
+                               const int end, Predictions *predictions);
+
+static void fprop_next_cells(const FFNet *ffnet, FFInferenceContext *context, Scalar *first_output,
+                             const Scalar first_goodness, Scalar *cell_goodnesses, const bool normalize);
 
 /**
  * @brief Builds a FFNet by creating multiple FFCell objects.
@@ -39,10 +51,11 @@ int parse_label(const double *target, const int num_classes);
  * @param beta1 The beta1 value of the Adam optimizer\.
  * @param beta2 The beta2 value of the Adam optimizer\.
  * @param loss_suite The loss function suite for the FFNet.
+ * @param rng The stream the initial weights are drawn from.
  * @return FFNet The constructed FFNet.
  */
-FFNet *new_ff_net(const int *layer_sizes, int num_layers, double (*act)(double), double (*pdact)(double),
-                  const double treshold, const double beta1, const double beta2, LossType loss)
+FFNet *new_ff_net(const int *layer_sizes, int num_layers, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
+                  const double treshold, const double beta1, const double beta2, LossType loss, Rng *rng)
 {
     FFNet *ffnet = (FFNet *)malloc(sizeof(FFNet));
     ffnet->loss = loss;
@@ -60,13 +73,70 @@ FFNet *new_ff_net(const int *layer_sizes, int num_layers, double (*act)(double),
     }
     log_info("Layers: %s", layers_str);
 
-    for (int i = 0; i < ffnet->num_cells; i++)
-        ffnet->layers[i] = new_ff_cell(layer_sizes[i], layer_sizes[i + 1], act, pdact, beta1, beta2);
+    build_ff_cells(ffnet, layer_sizes, act, pdact, beta1, beta2, NULL, rng);
 
     log_info("FFNet built with %d layers", ffnet->num_cells);
     return ffnet;
 }
 
+/**
+ * @brief Allocates the arena of a FFNet, or clears the given one, and builds its cells in it.
+ *
+ * @param ffnet The FFNet, with its number of cells set.
+ * @param layer_sizes The array of layer sizes, including the number of input and output units.
+ * @param act The activation function for the FFNet.
+ * @param pdact The derivative of the activation function for the FFNet.
+ * @param beta1 The beta1 value of the Adam optimizer.
+ * @param beta2 The beta2 value of the Adam optimizer.
+ * @param arena An arena built for the same layer sizes to reuse, NULL to allocate a new one.
+ * @param rng The stream the initial weights are drawn from, NULL to leave them zero.
+ */
+static void build_ff_cells(FFNet *ffnet, const int *layer_sizes, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
+                           const double beta1, const double beta2, Scalar *arena, Rng *rng)
+{
+    ffnet->num_parameters = 0;
+    for (int i = 0; i < ffnet->num_cells; i++)
+        ffnet->num_parameters += (long)layer_sizes[i] * layer_sizes[i + 1];
+
+    // Sections padded to keep each of them aligned.
+    const long section_align = ARENA_ALIGNMENT / sizeof(Scalar);
+    const long stride = (ffnet->num_parameters + section_align - 1) / section_align * section_align;
+    if (arena != NULL)
+    {
+        // Same state as a new arena.
+        memset(arena, 0, 4 * stride * sizeof(Scalar));
+        ffnet->parameters = arena;
+    }
+    else
+        ffnet->parameters = (Scalar *)new_arena(4 * stride * sizeof(Scalar));
+
+    Scalar *memory = ffnet->parameters;
+    for (int i = 0; i < ffnet->num_cells; i++)
+    {
+        ffnet->layers[i] = new_ff_cell(layer_sizes[i], layer_sizes[i + 1], act, pdact, beta1, beta2, memory, stride, rng);
+        memory += ffnet->layers[i].num_weights;
+    }
+    log_debug("FFNet arena holds %ld parameters", ffnet->num_parameters);
+}
+
+/**
+ * @brief Checks whether the cells of a FFNet have the given layer sizes.
+ *
+ * @param ffnet The FFNet.
+ * @param num_cells The number of cells.
+ * @param layer_sizes The array of layer sizes, including the number of input and output units.
+ * @return true if the FFNet has the same number of cells with the same sizes.
+ */
+static bool has_ff_layout(const FFNet *ffnet, const int num_cells, const int *layer_sizes)
+{
+    if (ffnet->num_cells != num_cells)
+        return false;
+    for (int i = 0; i < num_cells; i++)
+        if (ffnet->layers[i].input_size != layer_sizes[i] || ffnet->layers[i].output_size != layer_sizes[i + 1])
+            return false;
+    return true;
+}
+
 /**
  * @brief Frees the memory of a FFNet.
  *
@@ -74,8 +144,7 @@ FFNet *new_ff_net(const int *layer_sizes, int num_layers, double (*act)(double),
  */
 void free_ff_net(FFNet *ffnet)
 {
-    for (int i = 0; i < ffnet->num_cells; i++)
-        free_ff_cell(ffnet->layers[i]);
+    free_arena(ffnet->parameters);
     free(ffnet);
 }
 
@@ -90,14 +159,71 @@ void free_ff_net(FFNet *ffnet)
  * @return The training loss.
  */
 double train_ff_net(FFNet *ffnet, const FFBatch batch, const double learning_rate)
+{
+    return train_ff_net_parallel(ffnet, batch, learning_rate, NULL);
+}
+
+/**
+ * @brief Trains a FFNet by training each cell, splitting the outputs of each cell across the threads of a pool.
+ *
+ * @param ffnet The FFNet to train.
+ * @param batch Batch containing an array for positive samples and an array for negative samples.
+ * @param learning_rate The learning rate for the training.
+ * @param pool The thread pool, NULL to train serially.
+ * @return The training loss.
+ */
+double train_ff_net_parallel(FFNet *ffnet, const FFBatch batch, const double learning_rate, ThreadPool *pool)
 {
     double loss = 0.0;
-    loss += train_ff_cell(ffnet->layers[0], batch, learning_rate, ffnet->threshold, ffnet->loss);
-    for (int i = 1; i < ffnet->num_cells; i++)
-        loss += train_ff_cell(ffnet->layers[i], batch, learning_rate, ffnet->threshold, ffnet->loss);
+    for (int i = 0; i < ffnet->num_cells; i++)
+        loss += train_ff_cell_parallel(&ffnet->layers[i], batch, learning_rate, ffnet->threshold, ffnet->loss, pool);
     return loss / (ffnet->num_cells);
 }
 
+/**
+ * @brief Creates the scratch buffers needed by a thread to perform inference with a FFNet.
+ *
+ * @param ffnet The FFNet the context is sized for.
+ * @param num_classes The number of classes.
+ * @return The newly created inference context.
+ */
+FFInferenceContext *new_ff_inference_context(const FFNet *ffnet, const int num_classes)
+{
+    FFInferenceContext *context = (FFInferenceContext *)malloc(sizeof(FFInferenceContext));
+    context->num_classes = num_classes;
+
+    // All the buffers of the context share a single allocation.
+    int buffer_size = num_classes * ffnet->layers[0].output_size + 2 * ffnet->num_cells;
+    for (int i = 0; i < ffnet->num_cells; i++)
+        buffer_size += ffnet->layers[i].output_size;
+    context->buffer = (Scalar *)malloc(buffer_size * sizeof(Scalar));
+
+    Scalar *next = context->buffer;
+    context->first_outputs = next;
+    next += num_classes * ffnet->layers[0].output_size;
+    context->gt_goodnesses = next;
+    next += ffnet->num_cells;
+    context->cell_goodnesses = next;
+    next += ffnet->num_cells;
+    for (int i = 0; i < ffnet->num_cells; i++)
+    {
+        context->outputs[i] = next;
+        next += ffnet->layers[i].output_size;
+    }
+    return context;
+}
+
+/**
+ * @brief Frees the memory of an inference context.
+ *
+ * @param context The inference context to free.
+ */
+void free_ff_inference_context(FFInferenceContext *context)
+{
+    free(context->buffer);
+    free(context);
+}
+
 /**
  * Calculates the loss on the given dataset and adds the predictions to the metrics.
  *
@@ -105,20 +231,55 @@ double train_ff_net(FFNet *ffnet, const FFBatch batch, const double learning_rat
  * @param data The dataset to test the model on.
  * @return The average loss of the model on the dataset.
  */
-double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *predictions)
+double test_ff_net(const FFNet *ffnet, const Data *data, const int input_size, Predictions *predictions)
 {
+    (void)input_size; // The input size is the one of the first cell.
     // initialize predictions for metrics generation
     init_predictions(predictions);
-    // Buffer to store activations to feed the next layer.
-    double *netinput = (double *)malloc((input_size) * sizeof(double));
-    // History of goodnesses for the ground truth class.
-    double *gt_goodnesses = (double *)malloc((ffnet->num_cells) * sizeof(double));
+    FFInferenceContext *context = new_ff_inference_context(ffnet, data->num_class);
+    const double loss = test_ff_net_with_context(ffnet, context, data, predictions);
+    free_ff_inference_context(context);
+    return loss;
+}
+
+/**
+ * Calculates the loss on the given dataset using the buffers of an inference context
+ * and adds the predictions to the metrics.
+ *
+ * @param ffnet The FFNet model to test, not modified.
+ * @param context The inference context of the calling thread.
+ * @param data The dataset to test the model on.
+ * @param predictions The predictions to add to.
+ * @return The average loss of the model on the dataset.
+ */
+double test_ff_net_with_context(const FFNet *ffnet, FFInferenceContext *context, const Data *data,
+                                Predictions *predictions)
+{
+    return test_ff_net_rows(ffnet, context, data, 0, data->rows, predictions) / data->rows;
+}
+
+/**
+ * Calculates the loss on a range of rows of the dataset and adds their predictions to the metrics.
+ *
+ * @param ffnet The FFNet model to test, not modified.
+ * @param context The inference context of the calling thread.
+ * @param data The dataset to test the model on.
+ * @param begin The first row of the range.
+ * @param end The row after the last one of the range.
+ * @param predictions The predictions to add to.
+ * @return The sum of the losses of the rows.
+ */
+static double test_ff_net_rows(const FFNet *ffnet, FFInferenceContext *context, const Data *data, const int begin,
+                               const int end, Predictions *predictions)
+{
+    const int first_output_size = ffnet->layers[0].output_size;
     // Goodnesses and losses for each class.
-    double goodnesses[MAX_CLASSES], losses[MAX_CLASSES];
+    Scalar goodnesses[MAX_CLASSES], first_goodnesses[MAX_CLASSES];
+    double losses[MAX_CLASSES];
     Loss loss = select_loss(ffnet->loss);
     double loss_sum = 0.0;
     // For each sample in the dataset.
-    for (int i = 0; i < data->rows; i++)
+    for (int i = begin; i < end; i++)
     {
         // Initialize the goodnesses and losses.
         for (Label j = 0; j < data->num_class; j++)
@@ -127,16 +288,17 @@ double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *
             losses[j] = 0.0;
         }
         // Find the ground truth class.
-        Label ground_truth = parse_label(data->target[i], data->num_class);
+        Label ground_truth = parse_label(data_target(data, i), data->num_class);
         assert(ground_truth != -1);
+        // Forward propagation of the first cell for all the classes at once.
+        fprop_ff_cell_labels(ffnet->layers[0], data_input(data, i), data->num_class, context->first_outputs, first_goodnesses);
         // Perform forward propagation for the ground truth class and calculate its goodness for every cell.
-        embed_label(netinput, data->input[i], ground_truth, input_size, data->num_class);
+        fprop_next_cells(ffnet, context, &context->first_outputs[ground_truth * first_output_size],
+                         first_goodnesses[ground_truth], context->gt_goodnesses, false);
         for (int cell = 0; cell < ffnet->num_cells; cell++)
         {
-            fprop_ff_cell(ffnet->layers[cell], cell == 0 ? netinput : ffnet->layers[cell - 1].output);
-            gt_goodnesses[cell] = goodness(ffnet->layers[cell].output, ffnet->layers[cell].output_size);
-            goodnesses[ground_truth] += gt_goodnesses[cell];
-            losses[ground_truth] += loss.loss(gt_goodnesses[cell], gt_goodnesses[cell], ffnet->threshold);
+            goodnesses[ground_truth] += context->gt_goodnesses[cell];
+            losses[ground_truth] += loss.loss(context->gt_goodnesses[cell], context->gt_goodnesses[cell], ffnet->threshold);
         }
         // For each class perform forward propagation and calculate the goodness and loss.
         for (Label class = 0; class < data->num_class; class ++)
@@ -145,13 +307,12 @@ double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *
             if (class == ground_truth)
                 continue;
             // For each cell in the network perform forward propagation and calculate the goodness and loss.
-            embed_label(netinput, data->input[i], class, input_size, data->num_class);
+            fprop_next_cells(ffnet, context, &context->first_outputs[class * first_output_size],
+                             first_goodnesses[class], context->cell_goodnesses, false);
             for (int cell = 0; cell < ffnet->num_cells; cell++)
             {
-                fprop_ff_cell(ffnet->layers[cell], cell == 0 ? netinput : ffnet->layers[cell - 1].output);
-                const double cell_goodness = goodness(ffnet->layers[cell].output, ffnet->layers[cell].output_size);
-                goodnesses[class] += cell_goodness;
-                losses[class] += loss.loss(gt_goodnesses[cell], cell_goodness, ffnet->threshold);
+                goodnesses[class] += context->cell_goodnesses[cell];
+                losses[class] += loss.loss(context->gt_goodnesses[cell], context->cell_goodnesses[cell], ffnet->threshold);
             }
         }
 
@@ -169,13 +330,129 @@ double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *
         mean_loss /= data->num_class * ffnet->num_cells;
         loss_sum += mean_loss;
     }
-    free(netinput);
-    free(gt_goodnesses);
 
+    return loss_sum;
+}
+
+/**
+ * @brief Work of a worker testing a FFNet in parallel: a range of rows with its own buffers and results.
+ */
+typedef struct
+{
+    FFInferenceContext *context; // Inference buffers of the worker.
+    Predictions *predictions;    // Predictions of the rows of the worker.
+    double loss_sum;             // Sum of the losses of the rows of the worker.
+    int begin;                   // First row of the range.
+    int end;                     // Row after the last one of the range.
+} FFTestWork;
+
+/**
+ * @brief Shared state of a parallel test.
+ */
+typedef struct
+{
+    const FFNet *ffnet;
+    const Data *data;
+    FFTestWork *works;
+} FFTestJob;
+
+/**
+ * @brief Tests the range of rows of a worker.
+ *
+ * @param arg The FFTestJob.
+ * @param task_index The index of the worker.
+ */
+static void test_ff_net_task(void *arg, const int task_index)
+{
+    FFTestJob *job = (FFTestJob *)arg;
+    FFTestWork *work = &job->works[task_index];
+    work->loss_sum = test_ff_net_rows(job->ffnet, work->context, job->data, work->begin, work->end,
+                                      work->predictions);
+}
+
+/**
+ * Calculates the loss on the given dataset splitting its rows across the threads of a pool
+ * and adds the predictions to the metrics.
+ *
+ * Every thread tests a contiguous range of rows with its own inference context, loss sum and predictions,
+ * which are merged in row order at the end. The results are the same as the serial test_ff_net.
+ *
+ * @param ffnet The FFNet model to test.
+ * @param data The dataset to test the model on.
+ * @param predictions The predictions to initialize and fill.
+ * @param pool The thread pool, NULL to test serially.
+ * @return The average loss of the model on the dataset.
+ */
+double test_ff_net_parallel(const FFNet *ffnet, const Data *data, Predictions *predictions, ThreadPool *pool)
+{
+    init_predictions(predictions);
+    int num_works = thread_pool_size(pool);
+    if (num_works > data->rows)
+        num_works = data->rows;
+    if (num_works <= 1)
+    {
+        FFInferenceContext *context = new_ff_inference_context(ffnet, data->num_class);
+        const double loss = test_ff_net_with_context(ffnet, context, data, predictions);
+        free_ff_inference_context(context);
+        return loss;
+    }
+
+    FFTestWork *works = (FFTestWork *)malloc(num_works * sizeof(FFTestWork));
+    for (int i = 0; i < num_works; i++)
+    {
+        works[i].context = new_ff_inference_context(ffnet, data->num_class);
+        // The first worker adds its predictions directly to the output.
+        works[i].predictions = i == 0 ? predictions : (Predictions *)malloc(sizeof(Predictions));
+        init_predictions(works[i].predictions);
+        works[i].loss_sum = 0.0;
+        works[i].begin = (int)((long)data->rows * i / num_works);
+        works[i].end = (int)((long)data->rows * (i + 1) / num_works);
+    }
+
+    FFTestJob job = {ffnet, data, works};
+    thread_pool_run(pool, num_works, test_ff_net_task, &job);
+
+    // Merge the results in row order.
+    double loss_sum = works[0].loss_sum;
+    free_ff_inference_context(works[0].context);
+    for (int i = 1; i < num_works; i++)
+    {
+        loss_sum += works[i].loss_sum;
+        merge_predictions(predictions, works[i].predictions);
+        free(works[i].predictions);
+        free_ff_inference_context(works[i].context);
+    }
+    free(works);
     return loss_sum / data->rows;
 }
 
-int parse_label(const double *target, const int num_classes)
+/**
+ * @brief Propagates the output of the first cell for a label embedding through the remaining cells.
+ *
+ * @param ffnet The FFNet.
+ * @param context The inference context holding the output buffers of the cells.
+ * @param first_output The output of the first cell, normalized in place if required.
+ * @param first_goodness The goodness of the first cell.
+ * @param cell_goodnesses The goodness of each cell.
+ * @param normalize Whether to normalize the output of a cell before feeding it to the next one.
+ */
+static void fprop_next_cells(const FFNet *ffnet, FFInferenceContext *context, Scalar *first_output,
+                             const Scalar first_goodness, Scalar *cell_goodnesses, const bool normalize)
+{
+    cell_goodnesses[0] = first_goodness;
+    if (normalize)
+        normalize_vector(first_output, ffnet->layers[0].output_size);
+    for (int cell = 1; cell < ffnet->num_cells; cell++)
+    {
+        Scalar *output = context->outputs[cell];
+        fprop_ff_cell(ffnet->layers[cell], cell == 1 ? first_output : context->outputs[cell - 1], output);
+        cell_goodnesses[cell] = goodness(output, ffnet->layers[cell].output_size);
+        if (normalize)
+            normalize_vector(output, ffnet->layers[cell].output_size);
+    }
+}
+
+int parse_label(const Scalar *target, const int num_classes)
 {
     for (int i = 0; i < num_classes; i++)
     {
@@ -194,30 +471,42 @@ int parse_label(const double *target, const int num_classes)
  * @param input_size The size of the input data.
  * @return int The predicted class index.
  */
-int predict_ff_net(const FFNet *ffnet, const double *input, const int num_classes, const int input_size)
+int predict_ff_net(const FFNet *ffnet, const Scalar *input, const int num_classes, const int input_size)
+{
+    (void)input_size; // The input size is the one of the first cell.
+    FFInferenceContext *context = new_ff_inference_context(ffnet, num_classes);
+    const int prediction = predict_ff_net_with_context(ffnet, context, input);
+    free_ff_inference_context(context);
+    return prediction;
+}
+
+/**
+ * @brief Inference function for FFNet using the buffers of an inference context.
+ *
+ * @param ffnet The FFNet to perform inference on, not modified.
+ * @param context The inference context of the calling thread.
+ * @param input The input data.
+ * @return int The predicted class index.
+ */
+int predict_ff_net_with_context(const FFNet *ffnet, FFInferenceContext *context, const Scalar *input)
 {
+    const int num_classes = context->num_classes;
     log_debug("Predicting sample on model with cells: %d", ffnet->num_cells);
-    double *netinput = (double *)malloc((input_size) * sizeof(double));
-    double goodnesses[MAX_CLASSES];
-    // For debugging.
-    for (int i = 0; i < num_classes; i++)
-        goodnesses[i] = 0.0;
+    Scalar goodnesses[MAX_CLASSES], first_goodnesses[MAX_CLASSES];
+    // Forward propagation of the first cell for all the classes at once.
+    fprop_ff_cell_labels(ffnet->layers[0], input, num_classes, context->first_outputs, first_goodnesses);
 
     // For each class.
     for (int label = 0; label < num_classes; label++)
     {
-        embed_label(netinput, input, label, input_size, num_classes);
+        goodnesses[label] = 0.0;
+        fprop_next_cells(ffnet, context, &context->first_outputs[label * ffnet->layers[0].output_size],
+                         first_goodnesses[label], context->cell_goodnesses, true);
         for (int i = 0; i < ffnet->num_cells; i++)
-        {
-            fprop_ff_cell(ffnet->layers[i], i == 0 ? netinput : ffnet->layers[i - 1].output);
-            goodnesses[label] += goodness(ffnet->layers[i].output, ffnet->layers[i].output_size);
-            normalize_vector(ffnet->layers[i].output, ffnet->layers[i].output_size);
-            log_debug("Forward propagated label %d to network cell %d with cumulative goodness: %f", label, i, goodnesses[label]);
-        }
+            goodnesses[label] += context->cell_goodnesses[i];
+        log_debug("Forward propagated label %d with cumulative goodness: %f", label, goodnesses[label]);
     }
 
-    free(netinput);
-
     int max_goodness_index = 0;
     for (int i = 1; i < num_classes; i++)
     {
@@ -279,6 +568,12 @@ void save_ff_net(const FFNet *ffnet, const char *filename, bool default_path)
         return;
     }
 
+    // Write the header recording the precision of the weights.
+    const int magic = FFNET_CHECKPOINT_MAGIC;
+    const int scalar_size = sizeof(Scalar);
+    fwrite(&magic, sizeof(magic), 1, file);
+    fwrite(&scalar_size, sizeof(scalar_size), 1, file);
+
     fwrite(&ffnet->num_cells, sizeof(ffnet->num_cells), 1, file);
     fwrite(&ffnet->threshold, sizeof(ffnet->threshold), 1, file);
     fwrite(&ffnet->loss, sizeof(ffnet->loss), 1, file);
@@ -293,14 +588,14 @@ void save_ff_net(const FFNet *ffnet, const char *filename, bool default_path)
 /**
  * @brief Loads a FFNet from a file.
  *
- * @param ffnet The FFNet to load.
+ * @param ffnet The FFNet to load, built by new_ff_net or a previous load, or zero-initialized.
  * @param filename The name of the file to load the FFNet.
  * @param act The activation function.
  * @param pdact The derivative of the activation function.
  * @param beta1 The hyperparameter for the FF algorithm.
  * @param beta2 The hyperparameter for the FF algorithm.
  */
-void load_ff_net(FFNet *ffnet, const char *filename, double (*act)(double), double (*pdact)(double),
+void load_ff_net(FFNet *ffnet, const char *filename, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
                  const double beta1, const double beta2, bool default_path)
 {
     size_t res;
@@ -318,13 +613,38 @@ void load_ff_net(FFNet *ffnet, const char *filename, double (*act)(double), doub
         return;
     }
 
-    // Read the FFNet number of cells, threshold and loss function type.
-    res = fread(&ffnet->num_cells, sizeof(ffnet->num_cells), 1, file);
+    // Read the precision of the weights, checkpoints without header hold doubles.
+    int header;
+    int num_cells;
+    int scalar_size = sizeof(double);
+    res = fread(&header, sizeof(header), 1, file);
     if (res != 1)
     {
-        log_error("Could not read FFNet number of cells from file %s", filename);
+        log_error("Could not read FFNet header from file %s", filename);
         return;
     }
+    if (header == FFNET_CHECKPOINT_MAGIC)
+    {
+        res = fread(&scalar_size, sizeof(scalar_size), 1, file);
+        if (res != 1 || (scalar_size != sizeof(float) && scalar_size != sizeof(double)))
+        {
+            log_error("Could not read FFNet weights precision from file %s", filename);
+            return;
+        }
+        // Read the FFNet number of cells.
+        res = fread(&num_cells, sizeof(num_cells), 1, file);
+        if (res != 1)
+        {
+            log_error("Could not read FFNet number of cells from file %s", filename);
+            return;
+        }
+    }
+    else
+        num_cells = header;
+    if (scalar_size != sizeof(Scalar))
+        log_info("Converting FFNet weights from %d-byte to %d-byte floating point", scalar_size, (int)sizeof(Scalar));
+
+    // Read the FFNet threshold and loss function type.
     res = fread(&ffnet->threshold, sizeof(ffnet->threshold), 1, file);
     if (res != 1)
     {
@@ -338,10 +658,45 @@ void load_ff_net(FFNet *ffnet, const char *filename, double (*act)(double), doub
         return;
     }
 
-    log_debug("FFNet has %d cells, threshold %f and loss function type %d", ffnet->num_cells, ffnet->threshold, ffnet->loss);
+    log_debug("FFNet has %d cells, threshold %f and loss function type %d", num_cells, ffnet->threshold, ffnet->loss);
+
+    if (num_cells < 1 || num_cells > MAX_LAYERS_NUM)
+    {
+        log_error("Invalid FFNet number of cells %d in file %s", num_cells, filename);
+        return;
+    }
+
+    // First pass over the cells to read the layer sizes, needed to allocate the arena at once.
+    const long cells_offset = ftell(file);
+    int layer_sizes[MAX_LAYERS_NUM + 1];
+    for (int i = 0; i < num_cells; i++)
+    {
+        int sizes[2];
+        res = fread(sizes, sizeof(*sizes), 2, file);
+        if (res != 2 || (i > 0 && sizes[0] != layer_sizes[i]))
+        {
+            log_error("Could not read FFNet cell %d sizes from file %s", i, filename);
+            return;
+        }
+        layer_sizes[i] = sizes[0];
+        layer_sizes[i + 1] = sizes[1];
+        // Skip the weights and the bias.
+        fseek(file, ((long)sizes[0] * sizes[1] + 1) * scalar_size, SEEK_CUR);
+    }
 
+    // An arena of the same layout is reused, any other one is replaced.
+    Scalar *arena = NULL;
+    if (ffnet->parameters != NULL && has_ff_layout(ffnet, num_cells, layer_sizes))
+        arena = ffnet->parameters;
+    else if (ffnet->parameters != NULL)
+        free_arena(ffnet->parameters);
+    ffnet->num_cells = num_cells;
+
+    // The weights are read from the file, there is nothing to randomize.
+    build_ff_cells(ffnet, layer_sizes, act, pdact, beta1, beta2, arena, NULL);
+    fseek(file, cells_offset, SEEK_SET);
     for (int i = 0; i < ffnet->num_cells; i++)
-        ffnet->layers[i] = load_ff_cell(file, act, pdact, beta1, beta2);
+        load_ff_cell(&ffnet->layers[i], file, scalar_size);
 
     fclose(file);
     log_info("Loaded FFNet from file %s", filename);
@@ -12,16 +12,25 @@
 #include <ff-cell/ff-cell.h>
 #include <losses/losses.h>
 #include <predictions/predictions.h>
+#include <thread-pool/thread-pool.h>
 
 #define MAX_LAYERS_NUM 16
 
 #define FFNET_CHECKPOINT_PATH PROJECT_BASEPATH "/checkpoints"
 
+// Checkpoints start with this magic number followed by the size of the saved weights (the precision).
+// Checkpoints without it were saved before the precision was recorded and hold doubles.
+#define FFNET_CHECKPOINT_MAGIC 0x46464e54
+
 /**
  * @struct FFNet
  * @brief Struct that represents a forward forward neural network.
  *
  * The FFNet struct contains an array of FFCell blocks, the number of cells, the threshold value, and the loss function suite.
+ *
+ * The weights, gradients and Adam moments of all the cells live in a single aligned arena, in four sections
+ * of the same length. The first section holds the weights of the cells one after the other, so it is
+ * a flat view of all the parameters of the network in cell order.
  */
 typedef struct
 {
@@ -29,8 +38,27 @@ typedef struct
     int num_cells;                 // Number of cells in the network.
     double threshold;              // Threshold value for the cells in the network.
     LossType loss;                 // Loss function suite for the network.
+    Scalar *parameters;            // Arena of the network, starting with the weights of all the cells.
+    long num_parameters;           // Number of weights of all the cells.
 } FFNet;
 
+/**
+ * @struct FFInferenceContext
+ * @brief Scratch buffers used by a thread to perform inference with a FFNet.
+ *
+ * The FFNet is only read during inference, so any number of threads can share it as long as each one
+ * uses its own context. A context is allocated once and reused for every sample.
+ */
+typedef struct
+{
+    Scalar *first_outputs;           // Outputs of the first cell for every label embedding.
+    Scalar *outputs[MAX_LAYERS_NUM]; // Output buffer of each cell.
+    Scalar *gt_goodnesses;           // Goodness of each cell for the ground truth class.
+    Scalar *cell_goodnesses;         // Goodness of each cell for the current class.
+    int num_classes;                 // Number of classes the context is sized for.
+    Scalar *buffer;                  // Single allocation backing all the buffers.
+} FFInferenceContext;
+
 /**
  * @brief Builds a FFNet by creating multiple FFCell objects.
  *
@@ -46,9 +74,10 @@ typedef struct
  * @param beta1 The beta1 value of the Adam optimizer\.
  * @param beta2 The beta2 value of the Adam optimizer\.
  * @param loss_suite The loss function suite for the FFNet.
+ * @param rng The stream the initial weights are drawn from.
  * @return FFNet The constructed FFNet.
  */
-FFNet *new_ff_net(const int *layer_sizes, int num_layers, double (*act)(double), double (*pdact)(double), const double threshold, const double beta1, const double beta2, LossType loss_suite);
+FFNet *new_ff_net(const int *layer_sizes, int num_layers, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar), const double threshold, const double beta1, const double beta2, LossType loss_suite, Rng *rng);
 
 /**
  * @brief Frees the memory allocated for a FFNet.
@@ -71,6 +100,19 @@ void free_ff_net(FFNet *ffnet);
  */
 double train_ff_net(FFNet *ffnet, const FFBatch batch, const double learning_rate);
 
+/**
+ * @brief Trains a FFNet like train_ff_net, splitting the outputs of each cell across the threads of a pool.
+ *
+ * The trained weights are the same for any number of threads.
+ *
+ * @param ffnet The FFNet to train.
+ * @param batch Batch containing an array for positive samples and an array for negative samples.
+ * @param learning_rate The learning rate for the training.
+ * @param pool The thread pool, NULL to train serially.
+ * @return The training loss.
+ */
+double train_ff_net_parallel(FFNet *ffnet, const FFBatch batch, const double learning_rate, ThreadPool *pool);
+
 /**
  * Calculates the loss on the given dataset and adds the predictions to the metrics.
  *
@@ -78,7 +120,37 @@ double train_ff_net(FFNet *ffnet, const FFBatch batch, const double learning_rat
  * @param data The dataset to test the model on.
  * @return The average loss of the model on the dataset.
  */
-double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *predictions);
+double test_ff_net(const FFNet *ffnet, const Data *data, const int input_size, Predictions *predictions);
+
+/**
+ * Calculates the loss on the given dataset using the buffers of an inference context
+ * and adds the predictions to the metrics.
+ *
+ * The FFNet is not modified, so multiple threads can test the same FFNet with their own context.
+ *
+ * @param ffnet The FFNet model to test.
+ * @param context The inference context of the calling thread.
+ * @param data The dataset to test the model on.
+ * @param predictions The predictions to add to.
+ * @return The average loss of the model on the dataset.
+ */
+double test_ff_net_with_context(const FFNet *ffnet, FFInferenceContext *context, const Data *data,
+                                Predictions *predictions);
+
+/**
+ * Calculates the loss on the given dataset splitting its rows across the threads of a pool
+ * and adds the predictions to the metrics.
+ *
+ * Every thread accumulates its own loss sum and predictions, merged at the end in row order,
+ * so the results are the same as the ones of test_ff_net.
+ *
+ * @param ffnet The FFNet model to test.
+ * @param data The dataset to test the model on.
+ * @param predictions The predictions to initialize and fill.
+ * @param pool The thread pool, NULL to test serially.
+ * @return The average loss of the model on the dataset.
+ */
+double test_ff_net_parallel(const FFNet *ffnet, const Data *data, Predictions *predictions, ThreadPool *pool);
 
 /**
  * @brief Performs inference with a FFNet.
@@ -91,7 +163,35 @@ double test_ff_net(FFNet *ffnet, Data *data, const int input_size, Predictions *
  * @param input_size The size of the input data.
  * @return The predicted class label.
  */
-int predict_ff_net(const FFNet *ffnet, const double *input, const int num_classes, const int input_size);
+int predict_ff_net(const FFNet *ffnet, const Scalar *input, const int num_classes, const int input_size);
+
+/**
+ * @brief Performs inference with a FFNet using the buffers of an inference context.
+ *
+ * The FFNet is not modified, so multiple threads can use the same FFNet with their own context.
+ *
+ * @param ffnet The FFNet to use for inference.
+ * @param context The inference context of the calling thread.
+ * @param input The input data.
+ * @return The predicted class label.
+ */
+int predict_ff_net_with_context(const FFNet *ffnet, FFInferenceContext *context, const Scalar *input);
+
+/**
+ * @brief Creates an inference context for a FFNet.
+ *
+ * @param ffnet The FFNet the context is sized for.
+ * @param num_classes The number of classes.
+ * @return The newly created inference context.
+ */
+FFInferenceContext *new_ff_inference_context(const FFNet *ffnet, const int num_classes);
+
+/**
+ * @brief Frees the memory allocated for an inference context.
+ *
+ * @param context The inference context to free.
+ */
+void free_ff_inference_context(FFInferenceContext *context);
 
 /**
  * @brief Saves a FFNet to a file.
@@ -107,9 +207,10 @@ void save_ff_net(const FFNet *ffnet, const char *filename, bool default_path);
 /**
  * @brief Loads a FFNet from a file.
  *
- * This function loads a FFNet from a file.
+ * This function loads a FFNet from a file. A FFNet built with the same layer sizes keeps its arena,
+ * any other arena is freed and replaced. A freshly allocated FFNet must be zero-initialized.
  *
- * @param ffnet The FFNet to load.
+ * @param ffnet The FFNet to load, built by new_ff_net or a previous load, or zero-initialized.
  * @param filename The name of the file to load the FFNet.
  * @param act The activation function for the FFNet.
  * @param pdact The derivative of the activation function for the FFNet.
@@ -117,5 +218,5 @@ void save_ff_net(const FFNet *ffnet, const char *filename, bool default_path);
  * @param beta2 The beta2 value of the Adam optimizer.
  * @param default_path The flag to use the default path for the FFNet file.
  */
-void load_ff_net(FFNet *ffnet, const char *filename, double (*act)(double), double (*pdact)(double),
+void load_ff_net(FFNet *ffnet, const char *filename, Scalar (*act)(Scalar), Scalar (*pdact)(Scalar),
                  const double beta1, const double beta2, bool default_path);
@@ -0,0 +1,269 @@
+/**
+ * @file ff-pipeline.c
+ * @brief Implementation of the layer-pipelined training of a FFNet.
+ *
+ * The batches travel in a fixed set of slots. A slot index moves from the free queue to the queue of the first
+ * cell, then through the queues of the next cells, and back to the free queue once the last cell is done.
+ * The queues can hold every slot, so only an empty queue blocks.
+ */
+
+#include <ff-pipeline/ff-pipeline.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ff-cell/ff-cell.h>
+#include <logging/logging.h>
+
+#define STOP_SLOT -1 /**< Slot index that stops the thread of a cell. */
+
+/**
+ * @brief Blocking queue of slot indices.
+ */
+typedef struct
+{
+    int *items;               // Ring buffer of slot indices.
+    int capacity;             // Capacity of the ring buffer.
+    int head;                 // Index of the first item.
+    int count;                // Number of items.
+    pthread_mutex_t mutex;    // Protects the queue.
+    pthread_cond_t not_empty; // Signaled when an item is pushed.
+} SlotQueue;
+
+/**
+ * @brief Batch travelling through the pipeline.
+ */
+typedef struct
+{
+    FFBatch batch;        // Samples, replaced by the normalized activations of each cell.
+    double learning_rate; // Learning rate of the batch.
+    double loss;          // Sum of the losses of the cells which trained the batch.
+} Slot;
+
+/**
+ * @brief Argument of the thread of a cell.
+ */
+typedef struct
+{
+    FFPipeline *pipeline;
+    int cell;
+} Stage;
+
+struct FFPipeline
+{
+    FFNet *ffnet;                         // Trained FFNet.
+    Slot *slots;                          // Batches in the pipeline.
+    int num_slots;                        // Number of slots.
+    int sample_size;                      // Size of the samples of the batches.
+    SlotQueue free_slots;                 // Slots available for a new batch.
+    SlotQueue queues[MAX_LAYERS_NUM];     // Slots waiting for each cell.
+    Stage stages[MAX_LAYERS_NUM];         // Arguments of the threads.
+    pthread_t threads[MAX_LAYERS_NUM];    // Thread of each cell.
+    pthread_mutex_t mutex;                // Protects the counters and the loss.
+    pthread_cond_t completed;             // Signaled when the last cell completes a batch.
+    long pushed_batches;                  // Number of batches pushed.
+    long completed_batches;               // Number of batches trained by every cell.
+    double loss;                          // Sum of the losses since the last flush.
+    Logger *logger;                       // Logger of the creating thread, also used by the threads of the cells.
+};
+
+/**
+ * @brief Initializes a queue.
+ *
+ * @param queue The queue.
+ * @param capacity The maximum number of items.
+ */
+static void init_slot_queue(SlotQueue *queue, const int capacity);
+
+/**
+ * @brief Frees the memory of a queue.
+ *
+ * @param queue The queue.
+ */
+static void destroy_slot_queue(SlotQueue *queue);
+
+/**
+ * @brief Appends a slot index to a queue.
+ *
+ * @param queue The queue.
+ * @param slot The slot index.
+ */
+static void push_slot(SlotQueue *queue, const int slot);
+
+/**
+ * @brief Removes the first slot index from a queue, waiting for one if the queue is empty.
+ *
+ * @param queue The queue.
+ * @return The slot index.
+ */
+static int pop_slot(SlotQueue *queue);
+
+/**
+ * @brief Main loop of the thread of a cell: trains the cell on the batches of its queue.
+ *
+ * @param arg The Stage of the thread.
+ * @return Always NULL.
+ */
+static void *train_stage(void *arg);
+
+FFPipeline *new_ff_pipeline(FFNet *ffnet, const int batch_size, const int sample_size, const int num_slots)
+{
+    FFPipeline *pipeline = (FFPipeline *)malloc(sizeof(FFPipeline));
+    pipeline->ffnet = ffnet;
+    pipeline->num_slots = num_slots;
+    pipeline->sample_size = sample_size;
+    pipeline->slots = (Slot *)malloc(num_slots * sizeof(Slot));
+    pipeline->pushed_batches = 0;
+    pipeline->completed_batches = 0;
+    pipeline->loss = 0.0;
+    pipeline->logger = get_thread_logger();
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->completed, NULL);
+
+    // The queues also hold the stop index.
+    init_slot_queue(&pipeline->free_slots, num_slots + 1);
+    for (int i = 0; i < num_slots; i++)
+    {
+        pipeline->slots[i].batch = new_ff_batch(batch_size, sample_size);
+        push_slot(&pipeline->free_slots, i);
+    }
+    for (int i = 0; i < ffnet->num_cells; i++)
+        init_slot_queue(&pipeline->queues[i], num_slots + 1);
+
+    for (int i = 0; i < ffnet->num_cells; i++)
+    {
+        pipeline->stages[i].pipeline = pipeline;
+        pipeline->stages[i].cell = i;
+        if (pthread_create(&pipeline->threads[i], NULL, train_stage, &pipeline->stages[i]) != 0)
+        {
+            log_error("Could not create the training thread of cell %d", i);
+            exit(1);
+        }
+    }
+    log_debug("Training pipeline created with %d cells and %d slots", ffnet->num_cells, num_slots);
+    return pipeline;
+}
+
+void free_ff_pipeline(FFPipeline *pipeline)
+{
+    // The stop index follows the pushed batches through every cell.
+    push_slot(&pipeline->queues[0], STOP_SLOT);
+    for (int i = 0; i < pipeline->ffnet->num_cells; i++)
+    {
+        pthread_join(pipeline->threads[i], NULL);
+        destroy_slot_queue(&pipeline->queues[i]);
+    }
+    destroy_slot_queue(&pipeline->free_slots);
+    for (int i = 0; i < pipeline->num_slots; i++)
+        free_ff_batch(pipeline->slots[i].batch);
+    free(pipeline->slots);
+    pthread_cond_destroy(&pipeline->completed);
+    pthread_mutex_destroy(&pipeline->mutex);
+    free(pipeline);
+}
+
+void ff_pipeline_push(FFPipeline *pipeline, const FFBatch batch, const double learning_rate)
+{
+    const int index = pop_slot(&pipeline->free_slots);
+    Slot *slot = &pipeline->slots[index];
+    for (int i = 0; i < batch.size; i++)
+    {
+        memcpy(slot->batch.pos[i], batch.pos[i], pipeline->sample_size * sizeof(Scalar));
+        memcpy(slot->batch.neg[i], batch.neg[i], pipeline->sample_size * sizeof(Scalar));
+    }
+    slot->learning_rate = learning_rate;
+    slot->loss = 0.0;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->pushed_batches++;
+    pthread_mutex_unlock(&pipeline->mutex);
+    push_slot(&pipeline->queues[0], index);
+}
+
+double ff_pipeline_flush(FFPipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->completed_batches < pipeline->pushed_batches)
+        pthread_cond_wait(&pipeline->completed, &pipeline->mutex);
+    const double loss = pipeline->loss;
+    pipeline->loss = 0.0;
+    pthread_mutex_unlock(&pipeline->mutex);
+    return loss;
+}
+
+static void *train_stage(void *arg)
+{
+    const Stage *stage = (const Stage *)arg;
+    FFPipeline *pipeline = stage->pipeline;
+    FFNet *ffnet = pipeline->ffnet;
+    const bool last = stage->cell == ffnet->num_cells - 1;
+    set_thread_logger(pipeline->logger);
+    while (true)
+    {
+        const int index = pop_slot(&pipeline->queues[stage->cell]);
+        if (index == STOP_SLOT)
+        {
+            if (!last)
+                push_slot(&pipeline->queues[stage->cell + 1], STOP_SLOT);
+            break;
+        }
+
+        // Train the cell, the batch is replaced by its normalized activations.
+        Slot *slot = &pipeline->slots[index];
+        slot->loss += train_ff_cell(&ffnet->layers[stage->cell], slot->batch, slot->learning_rate, ffnet->threshold,
+                                    ffnet->loss);
+        if (!last)
+        {
+            push_slot(&pipeline->queues[stage->cell + 1], index);
+            continue;
+        }
+
+        // The batches complete in the order they were pushed, as in train_ff_net.
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->loss += slot->loss / ffnet->num_cells;
+        pipeline->completed_batches++;
+        pthread_cond_broadcast(&pipeline->completed);
+        pthread_mutex_unlock(&pipeline->mutex);
+        push_slot(&pipeline->free_slots, index);
+    }
+    return NULL;
+}
+
+static void init_slot_queue(SlotQueue *queue, const int capacity)
+{
+    queue->items = (int *)malloc(capacity * sizeof(int));
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+}
+
+static void destroy_slot_queue(SlotQueue *queue)
+{
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+}
+
+static void push_slot(SlotQueue *queue, const int slot)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->items[(queue->head + queue->count) % queue->capacity] = slot;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static int pop_slot(SlotQueue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0)
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    const int slot = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_mutex_unlock(&queue->mutex);
+    return slot;
+}
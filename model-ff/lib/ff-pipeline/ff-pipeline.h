@@ -0,0 +1,53 @@
+/**
+ * @file ff-pipeline.h
+ * @brief Header file for the layer-pipelined training of a FFNet.
+ *
+ * Each cell of the FFNet is trained by its own thread. A batch pushed in the pipeline is trained by the first cell,
+ * which replaces it with its normalized activations, and then handed to the next cell through a queue, so that
+ * the cells train on consecutive batches at the same time. Every cell trains on the same batches in the same order
+ * as train_ff_net, so the trained weights are the same.
+ */
+#pragma once
+
+#include <ff-net/ff-net.h>
+#include <data/data.h>
+
+/**
+ * @brief Opaque pipelined trainer of a FFNet.
+ */
+typedef struct FFPipeline FFPipeline;
+
+/**
+ * @brief Creates a pipeline training a FFNet and starts a thread for each of its cells.
+ *
+ * @param ffnet The FFNet to train, it must not be used until the pipeline is flushed.
+ * @param batch_size The number of samples of the batches.
+ * @param sample_size The size of the samples, the maximum of the layer sizes.
+ * @param num_slots The maximum number of batches in the pipeline, at least one per cell to keep all of them busy.
+ * @return The newly created pipeline.
+ */
+FFPipeline *new_ff_pipeline(FFNet *ffnet, const int batch_size, const int sample_size, const int num_slots);
+
+/**
+ * @brief Stops the threads and frees the memory of a pipeline, after training the pushed batches.
+ *
+ * @param pipeline The pipeline to free.
+ */
+void free_ff_pipeline(FFPipeline *pipeline);
+
+/**
+ * @brief Pushes a copy of a batch in the pipeline, waiting for a free slot if the pipeline is full.
+ *
+ * @param pipeline The pipeline.
+ * @param batch The batch to train the FFNet on, it can be reused as soon as the function returns.
+ * @param learning_rate The learning rate for the batch.
+ */
+void ff_pipeline_push(FFPipeline *pipeline, const FFBatch batch, const double learning_rate);
+
+/**
+ * @brief Waits for all the pushed batches to be trained by every cell.
+ *
+ * @param pipeline The pipeline.
+ * @return The sum of the losses of the batches trained since the last flush, as returned by train_ff_net.
+ */
+double ff_pipeline_flush(FFPipeline *pipeline);
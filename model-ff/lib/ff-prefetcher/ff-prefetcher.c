@@ -0,0 +1,147 @@
+/**
+ * @file ff-prefetcher.c
+ * @brief Implementation of the background generation of the training batches of a FFNet.
+ *
+ * Batch b of an epoch is generated in slot b % num_slots. The producer may only fill a slot once the batch
+ * it held has been released, which happens when the consumer takes the following batch.
+ */
+
+#include <ff-prefetcher/ff-prefetcher.h>
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <logging/logging.h>
+
+struct FFPrefetcher
+{
+    const Data *data;       // Training split the batches are generated from.
+    Rng *rng;               // Stream of the negative labels.
+    FFBatch *slots;         // Ring of batches.
+    int num_slots;          // Number of slots.
+    pthread_t thread;       // Producer thread.
+    pthread_mutex_t mutex;  // Protects the counters.
+    pthread_cond_t changed; // Signaled when a counter changes or the prefetcher stops.
+    int epoch_batches;      // Number of batches of the current epoch.
+    int produced;           // Number of batches generated in the current epoch.
+    int taken;              // Number of batches taken in the current epoch.
+    int released;           // Number of batches whose slot can be reused.
+    bool stop;              // Set to stop the producer thread.
+    Logger *logger;         // Logger of the creating thread, also used by the producer thread.
+};
+
+/**
+ * @brief Main loop of the producer thread: generates the batches of each epoch while there is a free slot.
+ *
+ * @param arg The FFPrefetcher.
+ * @return Always NULL.
+ */
+static void *produce_batches(void *arg);
+
+FFPrefetcher *new_ff_prefetcher(const Data *data, const int batch_size, const int sample_size, const int num_slots,
+                                Rng *rng)
+{
+    FFPrefetcher *prefetcher = (FFPrefetcher *)malloc(sizeof(FFPrefetcher));
+    prefetcher->data = data;
+    prefetcher->rng = rng;
+    prefetcher->num_slots = num_slots;
+    prefetcher->slots = (FFBatch *)malloc(num_slots * sizeof(FFBatch));
+    for (int i = 0; i < num_slots; i++)
+        prefetcher->slots[i] = new_ff_batch(batch_size, sample_size);
+    prefetcher->epoch_batches = 0;
+    prefetcher->produced = 0;
+    prefetcher->taken = 0;
+    prefetcher->released = 0;
+    prefetcher->stop = false;
+    prefetcher->logger = get_thread_logger();
+    pthread_mutex_init(&prefetcher->mutex, NULL);
+    pthread_cond_init(&prefetcher->changed, NULL);
+
+    if (pthread_create(&prefetcher->thread, NULL, produce_batches, prefetcher) != 0)
+    {
+        log_error("Could not create the batch prefetching thread");
+        exit(1);
+    }
+    log_debug("Batch prefetcher created with %d slots", num_slots);
+    return prefetcher;
+}
+
+void free_ff_prefetcher(FFPrefetcher *prefetcher)
+{
+    pthread_mutex_lock(&prefetcher->mutex);
+    prefetcher->stop = true;
+    pthread_cond_broadcast(&prefetcher->changed);
+    pthread_mutex_unlock(&prefetcher->mutex);
+    pthread_join(prefetcher->thread, NULL);
+
+    for (int i = 0; i < prefetcher->num_slots; i++)
+        free_ff_batch(prefetcher->slots[i]);
+    free(prefetcher->slots);
+    pthread_cond_destroy(&prefetcher->changed);
+    pthread_mutex_destroy(&prefetcher->mutex);
+    free(prefetcher);
+}
+
+void ff_prefetcher_begin_epoch(FFPrefetcher *prefetcher, const int num_batches)
+{
+    pthread_mutex_lock(&prefetcher->mutex);
+    if (prefetcher->taken < prefetcher->epoch_batches)
+    {
+        log_error("A new epoch was started before taking every batch of the previous one");
+        exit(1);
+    }
+    prefetcher->epoch_batches = num_batches;
+    prefetcher->produced = 0;
+    prefetcher->taken = 0;
+    prefetcher->released = 0;
+    pthread_cond_broadcast(&prefetcher->changed);
+    pthread_mutex_unlock(&prefetcher->mutex);
+}
+
+FFBatch ff_prefetcher_next(FFPrefetcher *prefetcher)
+{
+    pthread_mutex_lock(&prefetcher->mutex);
+    if (prefetcher->taken >= prefetcher->epoch_batches)
+    {
+        log_error("Every batch of the epoch has already been taken");
+        exit(1);
+    }
+    // The batch returned by the previous call is no longer used.
+    prefetcher->released = prefetcher->taken;
+    pthread_cond_broadcast(&prefetcher->changed);
+    while (prefetcher->produced <= prefetcher->taken)
+        pthread_cond_wait(&prefetcher->changed, &prefetcher->mutex);
+    const FFBatch batch = prefetcher->slots[prefetcher->taken % prefetcher->num_slots];
+    prefetcher->taken++;
+    pthread_mutex_unlock(&prefetcher->mutex);
+    return batch;
+}
+
+static void *produce_batches(void *arg)
+{
+    FFPrefetcher *prefetcher = (FFPrefetcher *)arg;
+    set_thread_logger(prefetcher->logger);
+    pthread_mutex_lock(&prefetcher->mutex);
+    while (true)
+    {
+        // Wait for a batch to generate and a free slot to generate it in.
+        while (!prefetcher->stop && (prefetcher->produced == prefetcher->epoch_batches ||
+                                     prefetcher->produced - prefetcher->released == prefetcher->num_slots))
+            pthread_cond_wait(&prefetcher->changed, &prefetcher->mutex);
+        if (prefetcher->stop)
+            break;
+
+        // The slot is not accessed by the consumer until the batch is counted as produced.
+        const int index = prefetcher->produced;
+        FFBatch batch = prefetcher->slots[index % prefetcher->num_slots];
+        pthread_mutex_unlock(&prefetcher->mutex);
+        generate_batch(prefetcher->data, index, batch, prefetcher->rng);
+        pthread_mutex_lock(&prefetcher->mutex);
+
+        prefetcher->produced++;
+        pthread_cond_broadcast(&prefetcher->changed);
+    }
+    pthread_mutex_unlock(&prefetcher->mutex);
+    return NULL;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file ff-prefetcher.h
+ * @brief Header file for the background generation of the training batches of a FFNet.
+ *
+ * A producer thread generates the next batches of an epoch into a ring of preallocated slots while the current
+ * batch is trained. The ring bounds how far the producer can run ahead. The batches are generated with
+ * generate_batch in the same order as the training loop would, so the trained weights are the same.
+ */
+#pragma once
+
+#include <data/data.h>
+
+/**
+ * @brief Opaque background generator of training batches.
+ */
+typedef struct FFPrefetcher FFPrefetcher;
+
+/**
+ * @brief Creates a prefetcher for a training split and starts its producer thread.
+ *
+ * @param data The training split, it must not be modified while an epoch is being generated.
+ * @param batch_size The number of samples of the batches.
+ * @param sample_size The size of the samples, the maximum of the layer sizes.
+ * @param num_slots The maximum number of batches generated ahead of the training.
+ * @param rng The stream of the negative labels, only used by the producer thread while an epoch is being generated.
+ * @return The newly created prefetcher.
+ */
+FFPrefetcher *new_ff_prefetcher(const Data *data, const int batch_size, const int sample_size, const int num_slots,
+                                Rng *rng);
+
+/**
+ * @brief Stops the producer thread and frees the memory of a prefetcher.
+ *
+ * @param prefetcher The prefetcher to free.
+ */
+void free_ff_prefetcher(FFPrefetcher *prefetcher);
+
+/**
+ * @brief Starts generating the batches of a new epoch.
+ *
+ * The training split must be shuffled before, with the stream of the prefetcher if needed, and every batch of the previous epoch must have been taken.
+ *
+ * @param prefetcher The prefetcher.
+ * @param num_batches The number of batches of the epoch.
+ */
+void ff_prefetcher_begin_epoch(FFPrefetcher *prefetcher, const int num_batches);
+
+/**
+ * @brief Takes the next batch of the epoch, waiting for it to be generated.
+ *
+ * The batch is owned by the prefetcher and can be used, and modified, until the next call.
+ *
+ * @param prefetcher The prefetcher.
+ * @return The next batch.
+ */
+FFBatch ff_prefetcher_next(FFPrefetcher *prefetcher);
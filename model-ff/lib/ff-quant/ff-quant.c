@@ -0,0 +1,407 @@
+/**
+ * @file ff-quant.c
+ * @brief Implementation of the int8 post-training quantized inference of a FFNet.
+ */
+
+#include <ff-quant/ff-quant.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tgmath.h>
+
+#include <ff-cell/ff-cell.h>
+#include <ff-utils/ff-utils.h>
+#include <logging/logging.h>
+
+int parse_label(const Scalar *target, const int num_classes);
+
+/**
+ * @brief Quantizes the weights of a FFCell with a symmetric scale per neuron.
+ *
+ * @param ffcell The FFCell to quantize.
+ * @return The quantized cell, with unit input scale.
+ */
+static FFQuantCell quantize_ff_cell(const FFCell ffcell);
+
+/**
+ * @brief Calibrates the input scale of every cell as the largest input magnitude over a set of samples.
+ *
+ * @param ffnet The FFNet.
+ * @param qnet The quantized FFNet whose input scales are set.
+ * @param calibration The calibration samples.
+ * @param num_samples The number of samples to use.
+ */
+static void calibrate_input_scales(const FFNet *ffnet, FFQuantNet *qnet, const Data *calibration, const int num_samples);
+
+/**
+ * @brief Quantizes a vector, after normalizing it if required.
+ *
+ * @param values The values to quantize.
+ * @param size The number of values.
+ * @param scale The scale of the quantized values.
+ * @param normalize Whether to normalize the values before quantizing them.
+ * @param quantized The quantized values.
+ */
+static void quantize_vector(const Scalar *values, const int size, const float scale, const bool normalize,
+                            int8_t *quantized);
+
+/**
+ * @brief Computes the int32 dot product of two int8 vectors.
+ *
+ * @param a The first vector.
+ * @param b The second vector.
+ * @param size The size of the vectors.
+ * @return The dot product.
+ */
+static int32_t dot_int8(const int8_t *a, const int8_t *b, const int size);
+
+/**
+ * @brief Performs forward propagation of a quantized cell.
+ *
+ * @param qcell The quantized cell.
+ * @param in The quantized inputs.
+ * @param out The output activations.
+ * @return The goodness of the output.
+ */
+static Scalar fprop_ff_quant_cell(const FFQuantCell qcell, const int8_t *in, Scalar *out);
+
+/**
+ * @brief Returns the largest absolute value of a vector.
+ *
+ * @param values The vector.
+ * @param size The size of the vector.
+ * @return The largest absolute value.
+ */
+static Scalar max_abs(const Scalar *values, const int size);
+
+FFQuantNet *quantize_ff_net(const FFNet *ffnet, const Data *calibration, const int num_samples)
+{
+    FFQuantNet *qnet = (FFQuantNet *)malloc(sizeof(FFQuantNet));
+    qnet->num_cells = ffnet->num_cells;
+    for (int i = 0; i < ffnet->num_cells; i++)
+    {
+        if (ffnet->layers[i].act != relu)
+        {
+            log_error("Only FFCells with ReLU activation can be quantized");
+            exit(1);
+        }
+        qnet->layers[i] = quantize_ff_cell(ffnet->layers[i]);
+    }
+    calibrate_input_scales(ffnet, qnet, calibration, num_samples);
+    for (int i = 0; i < qnet->num_cells; i++)
+        log_info("Quantized cell %d: input scale %f", i, qnet->layers[i].input_scale);
+    return qnet;
+}
+
+void free_ff_quant_net(FFQuantNet *qnet)
+{
+    for (int i = 0; i < qnet->num_cells; i++)
+    {
+        free(qnet->layers[i].weights);
+        free(qnet->layers[i].scales);
+    }
+    free(qnet);
+}
+
+FFQuantContext *new_ff_quant_context(const FFQuantNet *qnet, const int num_classes)
+{
+    FFQuantContext *context = (FFQuantContext *)malloc(sizeof(FFQuantContext));
+    context->num_classes = num_classes;
+    int max_input_size = 0, max_output_size = 0;
+    for (int i = 0; i < qnet->num_cells; i++)
+    {
+        if (qnet->layers[i].input_size > max_input_size)
+            max_input_size = qnet->layers[i].input_size;
+        if (qnet->layers[i].output_size > max_output_size)
+            max_output_size = qnet->layers[i].output_size;
+    }
+    context->input = (int8_t *)malloc(max_input_size * sizeof(int8_t));
+    context->first_outputs = (Scalar *)malloc(num_classes * qnet->layers[0].output_size * sizeof(Scalar));
+    context->outputs = (Scalar *)malloc(max_output_size * sizeof(Scalar));
+    return context;
+}
+
+void free_ff_quant_context(FFQuantContext *context)
+{
+    free(context->input);
+    free(context->first_outputs);
+    free(context->outputs);
+    free(context);
+}
+
+int predict_ff_quant_net(const FFQuantNet *qnet, FFQuantContext *context, const Scalar *input)
+{
+    const int num_classes = context->num_classes;
+    const FFQuantCell first = qnet->layers[0];
+    const int prefix_size = first.input_size - num_classes;
+    Scalar goodnesses[MAX_CLASSES];
+
+    // Forward propagation of the first cell for all the classes at once: the features are shared
+    // and the one-hot label selects a single weight column.
+    quantize_vector(input, prefix_size, first.input_scale, false, context->input);
+    const Scalar one = 1;
+    int8_t label_value;
+    quantize_vector(&one, 1, first.input_scale, false, &label_value);
+    for (int c = 0; c < num_classes; c++)
+        goodnesses[c] = 0;
+    for (int j = 0; j < first.output_size; j++)
+    {
+        const int8_t *weights = &first.weights[j * first.input_size];
+        const int32_t prefix = dot_int8(weights, context->input, prefix_size);
+        const float scale = first.input_scale * first.scales[j];
+        for (int c = 0; c < num_classes; c++)
+        {
+            const Scalar h = (prefix + label_value * weights[prefix_size + c]) * scale + first.bias;
+            const Scalar z = h > 0 ? h : 0;
+            context->first_outputs[c * first.output_size + j] = z;
+            goodnesses[c] += z * z;
+        }
+    }
+
+    // Propagate each label embedding through the remaining cells, normalizing the output of every cell.
+    for (int c = 0; c < num_classes; c++)
+    {
+        const Scalar *output = &context->first_outputs[c * first.output_size];
+        int output_size = first.output_size;
+        for (int cell = 1; cell < qnet->num_cells; cell++)
+        {
+            quantize_vector(output, output_size, qnet->layers[cell].input_scale, true, context->input);
+            goodnesses[c] += fprop_ff_quant_cell(qnet->layers[cell], context->input, context->outputs);
+            output = context->outputs;
+            output_size = qnet->layers[cell].output_size;
+        }
+    }
+
+    int max_goodness_index = 0;
+    for (int i = 1; i < num_classes; i++)
+        if (goodnesses[i] > goodnesses[max_goodness_index])
+            max_goodness_index = i;
+    return max_goodness_index;
+}
+
+FFQuantReport compare_ff_quant_net(const FFNet *ffnet, const FFQuantNet *qnet, const Data *data)
+{
+    FFQuantReport report = {0};
+    FFInferenceContext *context = new_ff_inference_context(ffnet, data->num_class);
+    FFQuantContext *quant_context = new_ff_quant_context(qnet, data->num_class);
+    int float_correct = 0, quant_correct = 0, agreements = 0;
+    for (int i = 0; i < data->rows; i++)
+    {
+        const int ground_truth = parse_label(data_target(data, i), data->num_class);
+        const int float_prediction = predict_ff_net_with_context(ffnet, context, data_input(data, i));
+        const int quant_prediction = predict_ff_quant_net(qnet, quant_context, data_input(data, i));
+        float_correct += float_prediction == ground_truth;
+        quant_correct += quant_prediction == ground_truth;
+        agreements += float_prediction == quant_prediction;
+    }
+    free_ff_inference_context(context);
+    free_ff_quant_context(quant_context);
+
+    report.float_accuracy = (double)float_correct / data->rows;
+    report.quant_accuracy = (double)quant_correct / data->rows;
+    report.agreement = (double)agreements / data->rows;
+    for (int i = 0; i < ffnet->num_cells; i++)
+    {
+        report.float_weight_bytes += (long)ffnet->layers[i].num_weights * sizeof(Scalar);
+        report.quant_weight_bytes += (long)ffnet->layers[i].num_weights * sizeof(int8_t) +
+                                     (long)ffnet->layers[i].output_size * sizeof(float);
+    }
+    return report;
+}
+
+void print_ff_quant_report(const FFQuantReport report)
+{
+    printf("Quantization report:\n");
+    printf("\tFloat accuracy: %f\n", report.float_accuracy);
+    printf("\tInt8 accuracy: %f (%+f)\n", report.quant_accuracy, report.quant_accuracy - report.float_accuracy);
+    printf("\tAgreement: %f\n", report.agreement);
+    printf("\tWeights memory: %ld bytes -> %ld bytes\n", report.float_weight_bytes, report.quant_weight_bytes);
+}
+
+void save_ff_quant_net(const FFQuantNet *qnet, const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        log_error("Could not open file %s for writing", filename);
+        return;
+    }
+    const int magic = FFQUANT_MAGIC;
+    fwrite(&magic, sizeof(magic), 1, file);
+    fwrite(&qnet->num_cells, sizeof(qnet->num_cells), 1, file);
+    for (int i = 0; i < qnet->num_cells; i++)
+    {
+        const FFQuantCell qcell = qnet->layers[i];
+        fwrite(&qcell.input_size, sizeof(qcell.input_size), 1, file);
+        fwrite(&qcell.output_size, sizeof(qcell.output_size), 1, file);
+        fwrite(&qcell.input_scale, sizeof(qcell.input_scale), 1, file);
+        fwrite(&qcell.bias, sizeof(qcell.bias), 1, file);
+        fwrite(qcell.scales, sizeof(*qcell.scales), qcell.output_size, file);
+        fwrite(qcell.weights, sizeof(*qcell.weights), qcell.input_size * qcell.output_size, file);
+    }
+    fclose(file);
+    log_info("Saved quantized FFNet to file %s", filename);
+}
+
+FFQuantNet *load_ff_quant_net(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        log_error("Could not open file %s for reading", filename);
+        return NULL;
+    }
+    int magic = 0;
+    FFQuantNet *qnet = (FFQuantNet *)malloc(sizeof(FFQuantNet));
+    qnet->num_cells = 0;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != FFQUANT_MAGIC ||
+        fread(&qnet->num_cells, sizeof(qnet->num_cells), 1, file) != 1 || qnet->num_cells < 1 ||
+        qnet->num_cells > MAX_LAYERS_NUM)
+    {
+        log_error("File %s is not a quantized FFNet", filename);
+        free(qnet);
+        fclose(file);
+        return NULL;
+    }
+    for (int i = 0; i < qnet->num_cells; i++)
+    {
+        FFQuantCell *qcell = &qnet->layers[i];
+        size_t res = fread(&qcell->input_size, sizeof(qcell->input_size), 1, file);
+        res += fread(&qcell->output_size, sizeof(qcell->output_size), 1, file);
+        res += fread(&qcell->input_scale, sizeof(qcell->input_scale), 1, file);
+        res += fread(&qcell->bias, sizeof(qcell->bias), 1, file);
+        if (res != 4)
+        {
+            log_error("Could not read quantized cell %d from file %s", i, filename);
+            exit(1);
+        }
+        const int num_weights = qcell->input_size * qcell->output_size;
+        qcell->scales = (float *)malloc(qcell->output_size * sizeof(float));
+        qcell->weights = (int8_t *)malloc(num_weights * sizeof(int8_t));
+        if (fread(qcell->scales, sizeof(float), qcell->output_size, file) != (size_t)qcell->output_size ||
+            fread(qcell->weights, sizeof(int8_t), num_weights, file) != (size_t)num_weights)
+        {
+            log_error("Could not read quantized weights of cell %d from file %s", i, filename);
+            exit(1);
+        }
+    }
+    fclose(file);
+    log_info("Loaded quantized FFNet from file %s", filename);
+    return qnet;
+}
+
+static FFQuantCell quantize_ff_cell(const FFCell ffcell)
+{
+    FFQuantCell qcell;
+    qcell.input_size = ffcell.input_size;
+    qcell.output_size = ffcell.output_size;
+    qcell.bias = ffcell.bias;
+    qcell.input_scale = 1;
+    qcell.weights = (int8_t *)malloc(ffcell.num_weights * sizeof(int8_t));
+    qcell.scales = (float *)malloc(ffcell.output_size * sizeof(float));
+    for (int j = 0; j < ffcell.output_size; j++)
+    {
+        const Scalar *weights = &ffcell.weights[j * ffcell.input_size];
+        const Scalar max_weight = max_abs(weights, ffcell.input_size);
+        // A neuron with null weights keeps a unit scale.
+        qcell.scales[j] = max_weight > 0 ? max_weight / FFQUANT_MAX_INT : 1;
+        quantize_vector(weights, ffcell.input_size, qcell.scales[j], false, &qcell.weights[j * ffcell.input_size]);
+    }
+    return qcell;
+}
+
+static void calibrate_input_scales(const FFNet *ffnet, FFQuantNet *qnet, const Data *calibration, const int num_samples)
+{
+    const int num_classes = calibration->num_class;
+    const int rows = num_samples < calibration->rows ? num_samples : calibration->rows;
+    const int first_output_size = ffnet->layers[0].output_size;
+    Scalar max_inputs[MAX_LAYERS_NUM] = {0};
+    // The one-hot label is part of the inputs of the first cell.
+    max_inputs[0] = 1;
+
+    FFInferenceContext *context = new_ff_inference_context(ffnet, num_classes);
+    Scalar first_goodnesses[MAX_CLASSES];
+    for (int i = 0; i < rows; i++)
+    {
+        // Rows in training order, so that the samples are not biased by the order of the file.
+        const Scalar *input = data_input(calibration, calibration->order[i]);
+        const Scalar max_feature = max_abs(input, ffnet->layers[0].input_size - num_classes);
+        if (max_feature > max_inputs[0])
+            max_inputs[0] = max_feature;
+
+        // Propagate every label embedding as predict_ff_net does and record the inputs of the next cells.
+        fprop_ff_cell_labels(ffnet->layers[0], input, num_classes, context->first_outputs, first_goodnesses);
+        for (int c = 0; c < num_classes; c++)
+        {
+            Scalar *output = &context->first_outputs[c * first_output_size];
+            for (int cell = 1; cell < ffnet->num_cells; cell++)
+            {
+                normalize_vector(output, ffnet->layers[cell - 1].output_size);
+                const Scalar max_input = max_abs(output, ffnet->layers[cell - 1].output_size);
+                if (max_input > max_inputs[cell])
+                    max_inputs[cell] = max_input;
+                fprop_ff_cell(ffnet->layers[cell], output, context->outputs[cell]);
+                output = context->outputs[cell];
+            }
+        }
+    }
+    free_ff_inference_context(context);
+
+    for (int cell = 0; cell < ffnet->num_cells; cell++)
+        qnet->layers[cell].input_scale = max_inputs[cell] > 0 ? max_inputs[cell] / FFQUANT_MAX_INT : 1;
+}
+
+static void quantize_vector(const Scalar *values, const int size, const float scale, const bool normalize,
+                            int8_t *quantized)
+{
+    Scalar inv_scale = 1 / (Scalar)scale;
+    if (normalize)
+    {
+        Scalar norm = 0;
+        for (int i = 0; i < size; i++)
+            norm += values[i] * values[i];
+        // A vector of inactive units cannot be normalized.
+        if (norm > 0)
+            inv_scale /= sqrt(norm);
+    }
+    for (int i = 0; i < size; i++)
+    {
+        Scalar q = round(values[i] * inv_scale);
+        if (q > FFQUANT_MAX_INT)
+            q = FFQUANT_MAX_INT;
+        else if (q < -FFQUANT_MAX_INT)
+            q = -FFQUANT_MAX_INT;
+        quantized[i] = (int8_t)q;
+    }
+}
+
+static int32_t dot_int8(const int8_t *a, const int8_t *b, const int size)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    return sum;
+}
+
+static Scalar fprop_ff_quant_cell(const FFQuantCell qcell, const int8_t *in, Scalar *out)
+{
+    Scalar goodness = 0;
+    for (int j = 0; j < qcell.output_size; j++)
+    {
+        const int32_t acc = dot_int8(&qcell.weights[j * qcell.input_size], in, qcell.input_size);
+        const Scalar h = acc * (qcell.input_scale * qcell.scales[j]) + qcell.bias;
+        const Scalar z = h > 0 ? h : 0;
+        out[j] = z;
+        goodness += z * z;
+    }
+    return goodness;
+}
+
+static Scalar max_abs(const Scalar *values, const int size)
+{
+    Scalar max = 0;
+    for (int i = 0; i < size; i++)
+        if (fabs(values[i]) > max)
+            max = fabs(values[i]);
+    return max;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file ff-quant.h
+ * @brief Header file for the int8 post-training quantized inference of a FFNet.
+ *
+ * The weights of each cell are quantized to int8 with a scale per neuron, and the inputs of each cell to int8
+ * with a scale calibrated on training samples. Dot products are accumulated in int32 and only the epilogue
+ * of each neuron (scaling, bias, ReLU, goodness) is computed in floating point.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <ff-net/ff-net.h>
+#include <data/data.h>
+
+#define FFQUANT_MAGIC 0x46465138 /**< Magic number of the quantized FFNet files. */
+
+#define FFQUANT_MAX_INT 127 /**< Largest magnitude of a quantized value, the range is symmetric. */
+
+/**
+ * @struct FFQuantCell
+ * @brief Quantized FFCell with ReLU activation.
+ */
+typedef struct
+{
+    int8_t *weights;   // Quantized weights (output_size x input_size, row-major).
+    float *scales;     // Scale of the quantized weights of each neuron.
+    float bias;        // Bias of the cell.
+    float input_scale; // Scale of the quantized inputs of the cell.
+    int input_size;    // Number of inputs.
+    int output_size;   // Number of outputs.
+} FFQuantCell;
+
+/**
+ * @struct FFQuantNet
+ * @brief Quantized FFNet.
+ */
+typedef struct
+{
+    FFQuantCell layers[MAX_LAYERS_NUM]; // Quantized cells.
+    int num_cells;                      // Number of cells.
+} FFQuantNet;
+
+/**
+ * @struct FFQuantContext
+ * @brief Scratch buffers used by a thread to perform inference with a FFQuantNet.
+ */
+typedef struct
+{
+    int8_t *input;         // Quantized input of the current cell.
+    Scalar *first_outputs; // Outputs of the first cell for every label embedding.
+    Scalar *outputs;       // Output of the current cell.
+    int num_classes;       // Number of classes the context is sized for.
+} FFQuantContext;
+
+/**
+ * @struct FFQuantReport
+ * @brief Comparison between a FFNet and its quantized version.
+ */
+typedef struct
+{
+    double float_accuracy;    // Accuracy of the FFNet.
+    double quant_accuracy;    // Accuracy of the FFQuantNet.
+    double agreement;         // Fraction of samples for which both predict the same class.
+    long float_weight_bytes;  // Memory of the weights of the FFNet.
+    long quant_weight_bytes;  // Memory of the weights and scales of the FFQuantNet.
+} FFQuantReport;
+
+/**
+ * @brief Quantizes a FFNet, calibrating the input scales on a set of samples.
+ *
+ * All the cells of the FFNet must use the ReLU activation.
+ *
+ * @param ffnet The FFNet to quantize.
+ * @param calibration The samples used to calibrate the input scales, usually the training split.
+ * @param num_samples The maximum number of samples used for the calibration.
+ * @return The quantized FFNet.
+ */
+FFQuantNet *quantize_ff_net(const FFNet *ffnet, const Data *calibration, const int num_samples);
+
+/**
+ * @brief Frees the memory of a quantized FFNet.
+ *
+ * @param qnet The quantized FFNet to free.
+ */
+void free_ff_quant_net(FFQuantNet *qnet);
+
+/**
+ * @brief Creates the inference buffers for a quantized FFNet.
+ *
+ * @param qnet The quantized FFNet.
+ * @param num_classes The number of classes.
+ * @return The inference context.
+ */
+FFQuantContext *new_ff_quant_context(const FFQuantNet *qnet, const int num_classes);
+
+/**
+ * @brief Frees the memory of a quantized inference context.
+ *
+ * @param context The context to free.
+ */
+void free_ff_quant_context(FFQuantContext *context);
+
+/**
+ * @brief Performs inference with a quantized FFNet, the same way as predict_ff_net.
+ *
+ * @param qnet The quantized FFNet, not modified.
+ * @param context The inference context of the calling thread.
+ * @param input The input data with room for the label embedding.
+ * @return The predicted class index.
+ */
+int predict_ff_quant_net(const FFQuantNet *qnet, FFQuantContext *context, const Scalar *input);
+
+/**
+ * @brief Compares the predictions of a FFNet and its quantized version on a dataset.
+ *
+ * @param ffnet The FFNet.
+ * @param qnet The quantized FFNet.
+ * @param data The dataset.
+ * @return The comparison report.
+ */
+FFQuantReport compare_ff_quant_net(const FFNet *ffnet, const FFQuantNet *qnet, const Data *data);
+
+/**
+ * @brief Prints a comparison report between a FFNet and its quantized version.
+ *
+ * @param report The report to print.
+ */
+void print_ff_quant_report(const FFQuantReport report);
+
+/**
+ * @brief Exports a quantized FFNet to a file.
+ *
+ * @param qnet The quantized FFNet to save.
+ * @param filename The name of the file.
+ */
+void save_ff_quant_net(const FFQuantNet *qnet, const char *filename);
+
+/**
+ * @brief Loads a quantized FFNet from a file.
+ *
+ * @param filename The name of the file.
+ * @return The loaded quantized FFNet, NULL if the file could not be read.
+ */
+FFQuantNet *load_ff_quant_net(const char *filename);
@@ -1,7 +1,7 @@
 #include <ff-utils/ff-utils.h>
 
 #include <string.h>
-#include <math.h>
+#include <tgmath.h>
 
 /**
  * Normalizes a vector.
@@ -9,11 +9,14 @@
  * @param vec The vector to be normalized.
  * @param size The size of the vector.
  */
-void normalize_vector(double *vec, int size)
+void normalize_vector(Scalar *vec, int size)
 {
-    double norm = 0.0;
+    Scalar norm = 0.0;
     for (int i = 0; i < size; i++)
         norm += vec[i] * vec[i];
+    // A vector of inactive units cannot be normalized.
+    if (norm == 0.0)
+        return;
     norm = sqrt(norm);
     for (int i = 0; i < size; i++)
         vec[i] /= norm;
@@ -26,9 +29,9 @@ void normalize_vector(double *vec, int size)
  * @param size The size of the vector.
  * @return The goodness of the layer.
  */
-double goodness(const double *vec, const int size)
+Scalar goodness(const Scalar *vec, const int size)
 {
-    double sum = 0.0;
+    Scalar sum = 0.0;
     for (int i = 0; i < size; i++)
         sum += vec[i] * vec[i];
     return sum;
@@ -43,7 +46,7 @@ double goodness(const double *vec, const int size)
  * @param input_size The size of the input vector.
  * @param num_classes The number of classes.
  */
-void embed_label(double *sample, const double *input, const int label, const int input_size, const int num_classes)
+void embed_label(Scalar *sample, const Scalar *input, const int label, const int input_size, const int num_classes)
 {
     memcpy(sample, input, input_size * sizeof(*input));
     memset(&sample[input_size - num_classes], 0, num_classes * sizeof(*sample));
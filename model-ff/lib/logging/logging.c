@@ -1,8 +1,17 @@
 /**
  * @file logging.c
  * @brief This file contains the logging utilities.
+ *
+ * The callers of a logger format their messages on their own stack, then copy them into the free records of
+ * the ring of the logger. A single writer thread, shared by all the loggers, appends the pending records of each
+ * logger to its log file and flushes it once per group of records, so the number of threads does not grow with
+ * the number of loggers. A caller only waits when the ring is full, or after an error message until it is
+ * written, so that the message is not lost if the program exits.
  * */
 
+// localtime_r is not part of C99.
+#define _DEFAULT_SOURCE
+
 #include <logging/logging.h>
 
 #include <string.h>
@@ -10,30 +19,160 @@
 #include <time.h>
 #include <stdarg.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 /**
- * @brief The current log level for logging messages.
+ * @brief Number of records of the ring of a logger.
  */
-static LogLevel currentLogLevel;
+#define LOG_RING_SIZE 256
 
 /**
- * @brief The global log file pointer.
+ * @brief Maximum length of a record, longer messages are truncated.
  */
-static FILE *globalLogFile;
+#define LOG_RECORD_SIZE 256
 
 /**
- * @brief The current indentation level for log messages.
+ * @brief Formatted message waiting to be written.
  */
-static int indentLevel = 0;
+typedef struct
+{
+    char text[LOG_RECORD_SIZE]; // Indentation, level, message and newline.
+    int length;                 // Length of the text.
+} LogRecord;
+
+struct Logger
+{
+    FILE *file;               // Log file.
+    LogLevel level;           // Lowest level written.
+    LogRecord *ring;          // Ring of the records, the records from head to head + count are pending.
+    int head;                 // Index of the first pending record.
+    int count;                // Number of pending records.
+    unsigned long pushed;     // Number of records pushed.
+    unsigned long written;    // Number of records written.
+    pthread_mutex_t mutex;    // Protects the ring and the counters.
+    pthread_cond_t drained;   // Signaled when records are written.
+    Logger *next;             // Next logger of the writer.
+};
 
 /**
- * Logs a message with the specified log level.
+ * @brief Logging state of a thread.
+ */
+typedef struct
+{
+    Logger *logger; // Logger of the thread, NULL for the default logger.
+    int indent;     // Indentation level of the messages of the thread.
+} ThreadLogState;
+
+/**
+ * @brief The default logger, used by the threads without a logger.
+ */
+static Logger *defaultLogger = NULL;
+
+/**
+ * @brief The log level of the default logger, also applied when it is opened.
+ */
+static LogLevel defaultLogLevel = LOG_DEBUG;
+
+/**
+ * @brief Protects the default logger.
+ */
+static pthread_mutex_t defaultMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Whether close_log_file is registered to run at exit.
+ */
+static int closeRegistered = 0;
+
+/**
+ * @brief Loggers drained by the writer thread, linked by their next field.
+ */
+static Logger *loggers = NULL;
+
+/**
+ * @brief Protects the list of loggers, held while draining them so that a logger is drained by one thread at a time.
+ */
+static pthread_mutex_t loggersMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Set when a logger has new pending records, cleared by the writer thread.
+ */
+static int recordsPending = 0;
+
+/**
+ * @brief Protects recordsPending, never held while taking another lock.
+ */
+static pthread_mutex_t pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Signaled when recordsPending is set.
+ */
+static pthread_cond_t pendingCond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief The writer thread, started with the first logger and running until the process exits.
+ */
+static pthread_t writer;
+static pthread_once_t writerOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Key of the ThreadLogState of each thread.
+ */
+static pthread_key_t stateKey;
+static pthread_once_t stateKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Creates the key of the thread states.
+ */
+static void create_state_key(void);
+
+/**
+ * Returns the logging state of the calling thread, creating it on first use.
  *
- * @param level The log level of the message.
- * @param format The format string for the message.
- * @param args The variable arguments list for the format string.
+ * @return The state of the thread.
+ */
+static ThreadLogState *thread_state(void);
+
+/**
+ * Opens a log file named after a timestamp.
+ *
+ * @param basepath The directory of the log file.
+ * @param name The name prefixed to the timestamp, NULL for none.
+ * @return The log file.
  */
-void log_message(LogLevel level, const char *format, va_list args);
+static FILE *open_timestamped_file(const char *basepath, const char *name);
+
+/**
+ * Starts the writer thread.
+ */
+static void start_writer(void);
+
+/**
+ * Main loop of the writer thread: drains the loggers whenever records are pushed.
+ *
+ * @param arg Unused.
+ * @return Always NULL.
+ */
+static void *write_records(void *arg);
+
+/**
+ * Writes the pending records of a logger and flushes its log file, with the mutex of the loggers held.
+ *
+ * @param logger The logger.
+ * @return Whether records were pushed while writing, and are still pending.
+ */
+static int drain_logger(Logger *logger);
+
+/**
+ * Wakes up the writer thread.
+ */
+static void wake_writer(void);
+
+/**
+ * Waits for the records pushed so far to a logger to be written, with the mutex of the logger held.
+ *
+ * @param logger The logger.
+ */
+static void wait_drained(Logger *logger);
 
 /**
  * Sets the current log level.
@@ -45,88 +184,136 @@ void log_message(LogLevel level, const char *format, va_list args);
  */
 void set_log_level(LogLevel level)
 {
-    currentLogLevel = level;
+    pthread_mutex_lock(&defaultMutex);
+    defaultLogLevel = level;
+    if (defaultLogger)
+        defaultLogger->level = level;
+    pthread_mutex_unlock(&defaultMutex);
 }
 
 /**
  * @brief Open a log file with a timestamp.
  *
- * The log file is created with a filename in the format "log_<timestamp>.log".
- * The log file is opened in write mode.
- * If the log file fails to open, an error message is printed and the program exits.
+ * The log file is created with a filename in the format "log_<timestamp>.log" and replaces the log file of
+ * the default logger. If the log file fails to open, an error message is printed and the program exits.
  *
  * @param None
  */
-void open_log_file_with_timestamp(const char* basepath)
+void open_log_file_with_timestamp(const char *basepath)
 {
-    // Get the current time
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-
-    // Create the log filename
-    char logFilename[512];
-    strftime(logFilename, sizeof(logFilename), "%Y-%m-%d_%H-%M-%S", tm_info);
-
-    // Calculate the required size for the full path
-    size_t path_len = snprintf(NULL, 0, "%s/log_%s.log", basepath, logFilename) + 1;
-    
-    // Allocate memory for the full path
-    char *fullPath = malloc(path_len);
-    if (!fullPath)
-    {
-        perror("Failed to allocate memory for model ff logging file full path");
-        exit(EXIT_FAILURE);
-    }
+    Logger *logger = new_logger(basepath, NULL, defaultLogLevel);
 
-    // Construct the full path
-    snprintf(fullPath, path_len, "%s/log_%s.log", basepath, logFilename);
-
-    // Create the log directory if it doesn't exist
-    mkdir(basepath, 0777);
-
-    // Open the log file
-    globalLogFile = fopen(fullPath, "w");
-    if (!globalLogFile)
-    {
-        perror("Failed to open log file");
-        free(fullPath);
-        exit(EXIT_FAILURE);
-    }
+    pthread_mutex_lock(&defaultMutex);
+    Logger *previous = defaultLogger;
+    defaultLogger = logger;
+    // The pending records are also written when the program exits without closing the log file.
+    if (!closeRegistered)
+        atexit(close_log_file);
+    closeRegistered = 1;
+    pthread_mutex_unlock(&defaultMutex);
 
-    // Free the allocated memory
-    free(fullPath);
+    if (previous)
+        free_logger(previous);
 }
 
 /**
  * @brief Closes the log file if it is open.
  *
- * This function checks if the globalLogFile is not NULL and closes the file using the fclose function.
+ * This function waits for the pending records of the default logger to be written and closes its file.
  *
  * @param None
  */
 void close_log_file(void)
 {
-    if (globalLogFile)
-    {
-        fclose(globalLogFile);
-    }
+    pthread_mutex_lock(&defaultMutex);
+    Logger *logger = defaultLogger;
+    defaultLogger = NULL;
+    pthread_mutex_unlock(&defaultMutex);
+
+    if (logger)
+        free_logger(logger);
+}
+
+Logger *new_logger(const char *basepath, const char *name, LogLevel level)
+{
+    Logger *logger = (Logger *)malloc(sizeof(Logger));
+    logger->file = open_timestamped_file(basepath, name);
+    logger->level = level;
+    logger->ring = (LogRecord *)malloc(LOG_RING_SIZE * sizeof(LogRecord));
+    logger->head = 0;
+    logger->count = 0;
+    logger->pushed = 0;
+    logger->written = 0;
+    pthread_mutex_init(&logger->mutex, NULL);
+    pthread_cond_init(&logger->drained, NULL);
+
+    pthread_once(&writerOnce, start_writer);
+    pthread_mutex_lock(&loggersMutex);
+    logger->next = loggers;
+    loggers = logger;
+    pthread_mutex_unlock(&loggersMutex);
+    return logger;
 }
+
+void free_logger(Logger *logger)
+{
+    // The writer does not touch the logger once it is unlinked, the remaining records are written here.
+    pthread_mutex_lock(&loggersMutex);
+    Logger **link = &loggers;
+    while (*link != logger)
+        link = &(*link)->next;
+    *link = logger->next;
+    drain_logger(logger);
+    pthread_mutex_unlock(&loggersMutex);
+
+    fclose(logger->file);
+    pthread_cond_destroy(&logger->drained);
+    pthread_mutex_destroy(&logger->mutex);
+    free(logger->ring);
+    free(logger);
+}
+
+Logger *set_thread_logger(Logger *logger)
+{
+    ThreadLogState *state = thread_state();
+    Logger *previous = state->logger;
+    state->logger = logger;
+    return previous;
+}
+
+Logger *get_thread_logger(void)
+{
+    return thread_state()->logger;
+}
+
 /**
  * Logs a message with the specified log level.
  *
  * @param level The log level of the message.
  * @param format The format string for the message.
- * @param args The variable arguments list for the format string.
+ * @param ... The variable arguments to be formatted and logged.
  */
-void log_message(LogLevel level, const char *format, va_list args)
+void log_write(LogLevel level, const char *format, ...)
 {
-    if (level < currentLogLevel)
+    ThreadLogState *state = thread_state();
+    Logger *logger = state->logger;
+    if (!logger)
     {
-        return;
+        // The default logger may be replaced, so it is only used with its mutex held.
+        pthread_mutex_lock(&defaultMutex);
+        logger = defaultLogger;
+        if (!logger)
+        {
+            pthread_mutex_unlock(&defaultMutex);
+            if (level >= defaultLogLevel)
+                fprintf(stderr, "Log file is not open.\n");
+            return;
+        }
     }
-    if (!globalLogFile)
+    if (level < logger->level)
     {
-        fprintf(stderr, "Log file is not open.\n");
+        if (!state->logger)
+            pthread_mutex_unlock(&defaultMutex);
         return;
     }
 
@@ -146,92 +333,201 @@ void log_message(LogLevel level, const char *format, va_list args)
         levelStr = "ERROR";
         break;
     }
-    for (int i = 0; i < indentLevel; i++)
+
+    // Format the record without holding any lock.
+    LogRecord record;
+    int length = 0;
+    for (int i = 0; i < state->indent && length < LOG_RECORD_SIZE - 1; i++)
+        record.text[length++] = '\t';
+    length += snprintf(record.text + length, LOG_RECORD_SIZE - length, "[%s] ", levelStr);
+    if (length < LOG_RECORD_SIZE - 1)
     {
-        fprintf(globalLogFile, "\t");
+        va_list args;
+        va_start(args, format);
+        length += vsnprintf(record.text + length, LOG_RECORD_SIZE - length, format, args);
+        va_end(args);
     }
-    fprintf(globalLogFile, "[%s] ", levelStr);
-    vfprintf(globalLogFile, format, args);
-    fprintf(globalLogFile, "\n");
-    fflush(globalLogFile);
+    // Truncated messages keep their newline.
+    if (length > LOG_RECORD_SIZE - 2)
+        length = LOG_RECORD_SIZE - 2;
+    record.text[length++] = '\n';
+    record.length = length;
+
+    pthread_mutex_lock(&logger->mutex);
+    while (logger->count == LOG_RING_SIZE)
+        pthread_cond_wait(&logger->drained, &logger->mutex);
+    // The record is free until it is counted as pending, the writer does not read it.
+    LogRecord *slot = &logger->ring[(logger->head + logger->count) % LOG_RING_SIZE];
+    memcpy(slot->text, record.text, record.length);
+    slot->length = record.length;
+    logger->count++;
+    logger->pushed++;
+    // The writer drains a logger until it has no pending records, so it only needs a wake up for the first one.
+    if (logger->count == 1)
+        wake_writer();
+    if (level == LOG_ERROR)
+        wait_drained(logger);
+    pthread_mutex_unlock(&logger->mutex);
+
+    if (!state->logger)
+        pthread_mutex_unlock(&defaultMutex);
 }
 
 /**
- * Logs a debug message with the specified format and arguments.
+ * @brief Increases the current indentation level.
  *
- * @param format The format string for the debug message.
- * @param ... The variable number of arguments to be formatted and logged.
+ * This function is used to increase the indentation level of the messages of the calling thread.
+ *
+ * @param None
  */
-void log_debug(const char *format, ...)
+void increase_indent(void)
 {
-    va_list args;
-    va_start(args, format);
-    log_message(LOG_DEBUG, format, args);
-    va_end(args);
+    thread_state()->indent++;
 }
 
 /**
- * Logs an informational message.
+ * @brief Decreases the current indentation level.
  *
- * @param format The format string for the message.
- * @param ... The variable arguments to be formatted and logged.
+ * This function is used to decrease the indentation level of the messages of the calling thread.
+ *
+ * @param None
  */
-void log_info(const char *format, ...)
+void decrease_indent(void)
 {
-    va_list args;
-    va_start(args, format);
-    log_message(LOG_INFO, format, args);
-    va_end(args);
+    thread_state()->indent--;
 }
 
-/**
- * Logs a warning message.
- *
- * @param format The format string for the message.
- * @param ... The variable arguments to be formatted and logged.
- */
-void log_warn(const char *format, ...)
+static void create_state_key(void)
 {
-    va_list args;
-    va_start(args, format);
-    log_message(LOG_WARN, format, args);
-    va_end(args);
+    pthread_key_create(&stateKey, free);
 }
 
-/**
- * Logs an error message.
- *
- * @param format The format string for the message.
- * @param ... The variable arguments to be formatted and logged.
- */
-void log_error(const char *format, ...)
+static ThreadLogState *thread_state(void)
 {
-    va_list args;
-    va_start(args, format);
-    log_message(LOG_ERROR, format, args);
-    va_end(args);
+    pthread_once(&stateKeyOnce, create_state_key);
+    ThreadLogState *state = (ThreadLogState *)pthread_getspecific(stateKey);
+    if (!state)
+    {
+        state = (ThreadLogState *)calloc(1, sizeof(ThreadLogState));
+        pthread_setspecific(stateKey, state);
+    }
+    return state;
 }
 
-/**
- * @brief Increases the current indentation level.
- *
- * This function is used to increase the current indentation level. It increments the value of the `indentLevel` variable by 1.
- *
- * @param None
- */
-void increase_indent(void)
+static FILE *open_timestamped_file(const char *basepath, const char *name)
+{
+    // Get the current time
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+
+    // Create the log filename
+    char logFilename[512];
+    strftime(logFilename, sizeof(logFilename), "%Y-%m-%d_%H-%M-%S", &tm_info);
+
+    // Calculate the required size for the full path
+    const char *separator = name ? "_" : "";
+    name = name ? name : "";
+    size_t path_len = snprintf(NULL, 0, "%s/log_%s%s%s.log", basepath, name, separator, logFilename) + 1;
+
+    // Allocate memory for the full path
+    char *fullPath = malloc(path_len);
+    if (!fullPath)
+    {
+        perror("Failed to allocate memory for model ff logging file full path");
+        exit(EXIT_FAILURE);
+    }
+
+    // Construct the full path
+    snprintf(fullPath, path_len, "%s/log_%s%s%s.log", basepath, name, separator, logFilename);
+
+    // Create the log directory if it doesn't exist
+    mkdir(basepath, 0777);
+
+    // Open the log file
+    FILE *file = fopen(fullPath, "w");
+    if (!file)
+    {
+        perror("Failed to open log file");
+        free(fullPath);
+        exit(EXIT_FAILURE);
+    }
+
+    // Free the allocated memory
+    free(fullPath);
+    return file;
+}
+
+static void wait_drained(Logger *logger)
 {
-    indentLevel++;
+    const unsigned long pushed = logger->pushed;
+    while (logger->written < pushed)
+        pthread_cond_wait(&logger->drained, &logger->mutex);
 }
 
-/**
- * @brief Decreases the current indentation level.
- *
- * This function is used to decrease the current indentation level. It decrements the value of the `indentLevel` variable by 1.
- *
- * @param None
- */
-void decrease_indent(void)
+static void start_writer(void)
+{
+    if (pthread_create(&writer, NULL, write_records, NULL) != 0)
+    {
+        perror("Failed to create the log writer thread");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(writer);
+}
+
+static void wake_writer(void)
 {
-    indentLevel--;
+    pthread_mutex_lock(&pendingMutex);
+    recordsPending = 1;
+    pthread_cond_signal(&pendingCond);
+    pthread_mutex_unlock(&pendingMutex);
+}
+
+static void *write_records(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        pthread_mutex_lock(&pendingMutex);
+        while (!recordsPending)
+            pthread_cond_wait(&pendingCond, &pendingMutex);
+        recordsPending = 0;
+        pthread_mutex_unlock(&pendingMutex);
+
+        int again = 0;
+        pthread_mutex_lock(&loggersMutex);
+        for (Logger *logger = loggers; logger != NULL; logger = logger->next)
+            again |= drain_logger(logger);
+        pthread_mutex_unlock(&loggersMutex);
+        if (again)
+            wake_writer();
+    }
+    return NULL;
+}
+
+static int drain_logger(Logger *logger)
+{
+    pthread_mutex_lock(&logger->mutex);
+    const int head = logger->head;
+    const int count = logger->count;
+    pthread_mutex_unlock(&logger->mutex);
+    if (count == 0)
+        return 0;
+
+    // The pending records are not modified until they are released, write them without the mutex of the logger.
+    for (int i = 0; i < count; i++)
+    {
+        const LogRecord *record = &logger->ring[(head + i) % LOG_RING_SIZE];
+        fwrite(record->text, 1, record->length, logger->file);
+    }
+    fflush(logger->file);
+
+    pthread_mutex_lock(&logger->mutex);
+    logger->head = (logger->head + count) % LOG_RING_SIZE;
+    logger->count -= count;
+    logger->written += count;
+    const int pending = logger->count > 0;
+    pthread_cond_broadcast(&logger->drained);
+    pthread_mutex_unlock(&logger->mutex);
+    return pending;
 }
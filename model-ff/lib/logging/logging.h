@@ -4,6 +4,14 @@
  *
  * This file contains the declarations for logging functions and macros.
  * It provides a convenient way to log messages during program execution.
+ *
+ * The statements below the level FF_LOG_ACTIVE_LEVEL are removed at compile time, and the messages are written
+ * to the log file by a background thread through a ring of records.
+ *
+ * Messages go to the logger of the calling thread, or to the default logger of the process if the thread has none.
+ * Each model can own a Logger with its own file, level and ring, so concurrent models do not contend with each other.
+ * A single writer thread, shared by all the loggers, writes the records of every logger to its file.
+ * The indentation is kept per thread.
  */
 #pragma once
 
@@ -15,64 +23,154 @@
 #endif
 
 /**
- * Opens the log file with a timestamp.
+ * Opens the log file of the default logger with a timestamp.
  */
 void open_log_file_with_timestamp(const char *basepath);
 
 /**
- * Closes the log file.
+ * Writes the pending messages and closes the log file of the default logger.
  */
 void close_log_file(void);
 
+/**
+ * Numeric values of the log levels, usable in preprocessor conditions.
+ */
+#define FF_LOG_LEVEL_DEBUG 0
+#define FF_LOG_LEVEL_INFO 1
+#define FF_LOG_LEVEL_WARN 2
+#define FF_LOG_LEVEL_ERROR 3
+
+/**
+ * Lowest log level compiled in: the statements of the lower levels are removed at compile time,
+ * arguments included. Defaults to FF_LOG_LEVEL_DEBUG, which keeps every statement.
+ */
+#ifndef FF_LOG_ACTIVE_LEVEL
+#define FF_LOG_ACTIVE_LEVEL FF_LOG_LEVEL_DEBUG
+#endif
+
 /**
  * Enumeration of log levels.
  */
 typedef enum
 {
-    LOG_DEBUG, // Detailed information, typically of interest only when diagnosing problems.
-    LOG_INFO,  // Informational messages that highlight the progress of the application.
-    LOG_WARN,  // Potentially harmful situations.
-    LOG_ERROR  // Error events that might still allow the application to continue running.
+    LOG_DEBUG = FF_LOG_LEVEL_DEBUG, // Detailed information, typically of interest only when diagnosing problems.
+    LOG_INFO = FF_LOG_LEVEL_INFO,   // Informational messages that highlight the progress of the application.
+    LOG_WARN = FF_LOG_LEVEL_WARN,   // Potentially harmful situations.
+    LOG_ERROR = FF_LOG_LEVEL_ERROR  // Error events that might still allow the application to continue running.
 } LogLevel;
 
 /**
- * Sets the log level.
+ * Sets the log level of the default logger.
  * 
  * @param level The log level to set.
  */
 void set_log_level(LogLevel level);
 
+/**
+ * Opaque logger writing to its own log file.
+ */
+typedef struct Logger Logger;
+
+/**
+ * Creates a logger writing to a new log file named after a timestamp, and registers it with the writer thread.
+ *
+ * @param basepath The directory of the log file, created if it does not exist.
+ * @param name The name prefixed to the timestamp in the file name, NULL for none.
+ * @param level The log level of the logger.
+ * @return The newly created logger.
+ */
+Logger *new_logger(const char *basepath, const char *name, LogLevel level);
+
+/**
+ * Writes the pending messages, unregisters a logger from the writer thread and closes its log file.
+ *
+ * The logger must no longer be the logger of any thread.
+ *
+ * @param logger The logger to free.
+ */
+void free_logger(Logger *logger);
+
+/**
+ * Sets the logger of the calling thread.
+ *
+ * @param logger The logger, NULL to use the default logger.
+ * @return The previous logger of the thread, NULL if it used the default logger.
+ */
+Logger *set_thread_logger(Logger *logger);
+
+/**
+ * Returns the logger of the calling thread, to hand it to the threads working on its behalf.
+ *
+ * @return The logger of the thread, NULL if it uses the default logger.
+ */
+Logger *get_thread_logger(void);
+
+/**
+ * Logs a message with the specified log level to the logger of the calling thread.
+ *
+ * The message is formatted by the calling thread and written to the log file by a background thread,
+ * so the caller never waits for the file. Error messages are written before the function returns.
+ *
+ * @param level The log level of the message.
+ * @param format The format string for the message.
+ * @param ... The additional arguments for the format string.
+ */
+void log_write(LogLevel level, const char *format, ...);
+
+/**
+ * Statement of a level removed at compile time. The call is kept in dead code, so its arguments are still
+ * type checked and count as used, and the optimizer drops it together with the computations only it needs.
+ */
+#define FF_LOG_DISABLED(level, ...)            \
+    do                                         \
+    {                                          \
+        if (0)                                 \
+            log_write(level, __VA_ARGS__);     \
+    } while (0)
+
 /**
  * Logs a debug message.
- * 
+ *
  * @param format The format string for the message.
  * @param ... The additional arguments for the format string.
  */
-void log_debug(const char *format, ...);
+#if FF_LOG_ACTIVE_LEVEL <= FF_LOG_LEVEL_DEBUG
+#define log_debug(...) log_write(LOG_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) FF_LOG_DISABLED(LOG_DEBUG, __VA_ARGS__)
+#endif
 
 /**
  * Logs an informational message.
- * 
+ *
  * @param format The format string for the message.
  * @param ... The additional arguments for the format string.
  */
-void log_info(const char *format, ...);
+#if FF_LOG_ACTIVE_LEVEL <= FF_LOG_LEVEL_INFO
+#define log_info(...) log_write(LOG_INFO, __VA_ARGS__)
+#else
+#define log_info(...) FF_LOG_DISABLED(LOG_INFO, __VA_ARGS__)
+#endif
 
 /**
  * Logs a warning message.
- * 
+ *
  * @param format The format string for the message.
  * @param ... The additional arguments for the format string.
  */
-void log_warn(const char *format, ...);
+#if FF_LOG_ACTIVE_LEVEL <= FF_LOG_LEVEL_WARN
+#define log_warn(...) log_write(LOG_WARN, __VA_ARGS__)
+#else
+#define log_warn(...) FF_LOG_DISABLED(LOG_WARN, __VA_ARGS__)
+#endif
 
 /**
- * Logs an error message.
- * 
+ * Logs an error message, error messages are never removed.
+ *
  * @param format The format string for the message.
  * @param ... The additional arguments for the format string.
  */
-void log_error(const char *format, ...);
+#define log_error(...) log_write(LOG_ERROR, __VA_ARGS__)
 
 /**
  * Increases the indentation level for log messages.
@@ -0,0 +1,14 @@
+/**
+ * @file rng.c
+ * @brief Implementation of the counter-based random number generators of the FF engine.
+ */
+
+#include <rng/rng.h>
+
+Rng new_rng(const uint64_t seed, const uint64_t stream)
+{
+    // The key is a number of the stream of the seed, so nearby seeds and stream indices give unrelated keys.
+    const Rng seed_stream = {seed, 0};
+    const Rng rng = {rng_at(&seed_stream, stream), 0};
+    return rng;
+}
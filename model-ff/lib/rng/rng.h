@@ -0,0 +1,83 @@
+/**
+ * @file rng.h
+ * @brief Header file for the counter-based random number generators of the FF engine.
+ *
+ * The i-th number of a stream is a hash of the key of the stream and of i, so a generator holds no hidden state
+ * besides its counter. Every client or thread draws from its own stream, without locks, and the numbers only
+ * depend on the seed, the stream and the order of the draws of that stream.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @struct Rng
+ * @brief Stream of random numbers.
+ */
+typedef struct
+{
+    uint64_t key;     // Key of the stream, derived from the seed and the stream index.
+    uint64_t counter; // Index of the next number of the stream.
+} Rng;
+
+/**
+ * @brief Creates a stream of random numbers.
+ *
+ * Streams created with the same seed and different stream indices are independent.
+ *
+ * @param seed The seed.
+ * @param stream The index of the stream.
+ * @return The stream, positioned on its first number.
+ */
+Rng new_rng(const uint64_t seed, const uint64_t stream);
+
+/**
+ * @brief Returns a number of a stream without advancing it.
+ *
+ * Finalizer of SplitMix64 applied to the key plus the index times the golden ratio.
+ *
+ * @param rng The stream.
+ * @param index The index of the number.
+ * @return The number, uniformly distributed over 64 bits.
+ */
+static inline uint64_t rng_at(const Rng *rng, const uint64_t index)
+{
+    uint64_t z = rng->key + (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Draws the next number of a stream.
+ *
+ * @param rng The stream.
+ * @return The number, uniformly distributed over 64 bits.
+ */
+static inline uint64_t rng_next(Rng *rng)
+{
+    return rng_at(rng, rng->counter++);
+}
+
+/**
+ * @brief Draws a number in [0, 1) from a stream.
+ *
+ * @param rng The stream.
+ * @return The number, with 53 random bits.
+ */
+static inline double rng_uniform(Rng *rng)
+{
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Draws an integer in [0, bound) from a stream, with the multiply-shift reduction.
+ *
+ * @param rng The stream.
+ * @param bound The exclusive upper bound, greater than 0.
+ * @return The integer.
+ */
+static inline uint32_t rng_below(Rng *rng, const uint32_t bound)
+{
+    return (uint32_t)(((rng_next(rng) >> 32) * bound) >> 32);
+}
@@ -0,0 +1,15 @@
+/**
+ * @file scalar.h
+ * @brief Header file defining the floating point type of the FF engine.
+ *
+ * Weights, optimizer state, gradients, batches and datasets are stored as Scalar.
+ * The engine is built in double precision by default, defining FF_SINGLE_PRECISION
+ * builds it in single precision, halving memory and doubling the SIMD width.
+ */
+#pragma once
+
+#ifdef FF_SINGLE_PRECISION
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
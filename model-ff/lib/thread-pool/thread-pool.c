@@ -0,0 +1,216 @@
+/**
+ * @file thread-pool.c
+ * @brief Implementation of a fixed-size pool of worker threads.
+ *
+ * Submitted jobs are kept in a queue. Workers and submitting threads claim the tasks of the job at the
+ * head of the queue one at a time, and the submitting thread waits for the completion of the tasks
+ * claimed by the workers before returning.
+ */
+
+#include <thread-pool/thread-pool.h>
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <logging/logging.h>
+
+/**
+ * @brief Job submitted to the thread pool.
+ */
+typedef struct ThreadPoolJob
+{
+    ThreadPoolTask task;        // Function executing a task.
+    void *arg;                  // Argument shared by the tasks.
+    Logger *logger;             // Logger of the submitting thread, also used by the workers.
+    int num_tasks;              // Number of tasks of the job.
+    int next_task;              // Index of the next task to claim.
+    int completed_tasks;        // Number of completed tasks.
+    pthread_cond_t completed;   // Signaled when all the tasks are completed.
+    struct ThreadPoolJob *next; // Next job in the queue.
+} ThreadPoolJob;
+
+struct ThreadPool
+{
+    pthread_mutex_t mutex;  // Protects the queue and the jobs state.
+    pthread_cond_t pending; // Signaled when a job is submitted or the pool is stopped.
+    ThreadPoolJob *head;    // First job of the queue.
+    ThreadPoolJob *tail;    // Last job of the queue.
+    pthread_t *workers;     // Worker threads.
+    int num_workers;        // Number of worker threads.
+    bool stop;              // Whether the workers must exit.
+};
+
+/**
+ * @brief Claims the next task of the job at the head of the queue. Must be called with the mutex held.
+ *
+ * @param pool The thread pool.
+ * @param task_index The index of the claimed task.
+ * @return The job of the claimed task, NULL if the queue is empty.
+ */
+static ThreadPoolJob *claim_task(ThreadPool *pool, int *task_index);
+
+/**
+ * @brief Marks a task as completed. Must be called with the mutex held.
+ *
+ * @param job The job of the task.
+ */
+static void complete_task(ThreadPoolJob *job);
+
+/**
+ * @brief Main loop of a worker thread.
+ *
+ * @param arg The thread pool.
+ * @return Always NULL.
+ */
+static void *worker_loop(void *arg);
+
+ThreadPool *new_thread_pool(const int num_threads)
+{
+    ThreadPool *pool = (ThreadPool *)malloc(sizeof(ThreadPool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->pending, NULL);
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->stop = false;
+    // The submitting thread is one of the threads executing a job.
+    pool->num_workers = num_threads > 1 ? num_threads - 1 : 0;
+    pool->workers = (pthread_t *)malloc((pool->num_workers > 0 ? pool->num_workers : 1) * sizeof(pthread_t));
+    for (int i = 0; i < pool->num_workers; i++)
+    {
+        if (pthread_create(&pool->workers[i], NULL, worker_loop, pool) != 0)
+        {
+            log_error("Could not create thread pool worker %d", i);
+            pool->num_workers = i;
+            break;
+        }
+    }
+    log_debug("Thread pool created with %d workers", pool->num_workers);
+    return pool;
+}
+
+void free_thread_pool(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->pending);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->num_workers; i++)
+        pthread_join(pool->workers[i], NULL);
+    pthread_cond_destroy(&pool->pending);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool *pool)
+{
+    return pool == NULL ? 1 : pool->num_workers + 1;
+}
+
+void thread_pool_run(ThreadPool *pool, const int num_tasks, ThreadPoolTask task, void *arg)
+{
+    if (pool == NULL || pool->num_workers == 0 || num_tasks == 1)
+    {
+        for (int i = 0; i < num_tasks; i++)
+            task(arg, i);
+        return;
+    }
+
+    ThreadPoolJob job;
+    job.task = task;
+    job.arg = arg;
+    job.logger = get_thread_logger();
+    job.num_tasks = num_tasks;
+    job.next_task = 0;
+    job.completed_tasks = 0;
+    job.next = NULL;
+    pthread_cond_init(&job.completed, NULL);
+
+    pthread_mutex_lock(&pool->mutex);
+    // Enqueue the job and wake up the workers.
+    if (pool->tail == NULL)
+        pool->head = &job;
+    else
+        pool->tail->next = &job;
+    pool->tail = &job;
+    pthread_cond_broadcast(&pool->pending);
+
+    // Take part in the execution of the job until all its tasks are claimed.
+    while (job.next_task < job.num_tasks)
+    {
+        const int task_index = job.next_task++;
+        if (job.next_task == job.num_tasks)
+        {
+            // Last task claimed: remove the job from the queue.
+            ThreadPoolJob **link = &pool->head;
+            ThreadPoolJob *previous = NULL;
+            while (*link != &job)
+            {
+                previous = *link;
+                link = &(*link)->next;
+            }
+            *link = job.next;
+            if (pool->tail == &job)
+                pool->tail = previous;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        task(arg, task_index);
+        pthread_mutex_lock(&pool->mutex);
+        complete_task(&job);
+    }
+
+    // Wait for the tasks claimed by the workers.
+    while (job.completed_tasks < job.num_tasks)
+        pthread_cond_wait(&job.completed, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_cond_destroy(&job.completed);
+}
+
+static ThreadPoolJob *claim_task(ThreadPool *pool, int *task_index)
+{
+    ThreadPoolJob *job = pool->head;
+    if (job == NULL)
+        return NULL;
+    *task_index = job->next_task++;
+    if (job->next_task == job->num_tasks)
+    {
+        // Last task claimed: remove the job from the queue.
+        pool->head = job->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+    }
+    return job;
+}
+
+static void complete_task(ThreadPoolJob *job)
+{
+    job->completed_tasks++;
+    if (job->completed_tasks == job->num_tasks)
+        pthread_cond_signal(&job->completed);
+}
+
+static void *worker_loop(void *arg)
+{
+    ThreadPool *pool = (ThreadPool *)arg;
+    pthread_mutex_lock(&pool->mutex);
+    while (true)
+    {
+        int task_index;
+        ThreadPoolJob *job = claim_task(pool, &task_index);
+        if (job == NULL)
+        {
+            if (pool->stop)
+                break;
+            pthread_cond_wait(&pool->pending, &pool->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        set_thread_logger(job->logger);
+        job->task(job->arg, task_index);
+        pthread_mutex_lock(&pool->mutex);
+        complete_task(job);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file thread-pool.h
+ * @brief Header file for a fixed-size pool of worker threads.
+ *
+ * The pool runs jobs made of independent tasks identified by their index. The thread submitting a job
+ * takes part in its execution, so jobs can be submitted concurrently from several threads.
+ */
+#pragma once
+
+/**
+ * @brief Opaque thread pool object.
+ */
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * @brief Function executing a single task of a job.
+ *
+ * @param arg The argument shared by all the tasks of the job.
+ * @param task_index The index of the task.
+ */
+typedef void (*ThreadPoolTask)(void *arg, const int task_index);
+
+/**
+ * @brief Creates a new thread pool.
+ *
+ * @param num_threads The number of threads executing a job, including the submitting thread.
+ * @return The newly created thread pool.
+ */
+ThreadPool *new_thread_pool(const int num_threads);
+
+/**
+ * @brief Stops the workers and frees the memory of a thread pool.
+ *
+ * @param pool The thread pool to free.
+ */
+void free_thread_pool(ThreadPool *pool);
+
+/**
+ * @brief Returns the number of threads executing a job, including the submitting thread.
+ *
+ * @param pool The thread pool, NULL for serial execution.
+ * @return The number of threads of the pool.
+ */
+int thread_pool_size(const ThreadPool *pool);
+
+/**
+ * @brief Runs a job on the thread pool and waits for all its tasks to complete.
+ *
+ * @param pool The thread pool, NULL to run the tasks serially on the calling thread.
+ * @param num_tasks The number of tasks of the job.
+ * @param task The function executing a task.
+ * @param arg The argument passed to every task.
+ */
+void thread_pool_run(ThreadPool *pool, const int num_tasks, ThreadPoolTask task, void *arg);
@@ -3,7 +3,7 @@
  * @brief This file contains utility functions for the lightweight neural network model.
  *
  * This file includes the necessary header files and defines utility functions used in the model.
- * The functions in this file provide various utility operations such as file I/O, memory allocation, and random number generation.
+ * The functions in this file provide various utility operations such as file I/O, memory allocation, and progress reporting.
  */
 
 #include <stdlib.h>
@@ -81,50 +81,22 @@ char *read_line_from_file(FILE *const file)
 
 /// TODO: enforce contiguous memory allocation.
 /**
- * @brief Create a matrix of doubles.
+ * @brief Create a matrix of Scalar values.
  *
- * This function creates a matrix of doubles with the specified number of rows and columns.
+ * This function creates a matrix of Scalar values with the specified number of rows and columns.
  *
  * @param rows The number of rows in the matrix.
  * @param cols The number of columns in the matrix.
  * @return The created matrix.
  */
-double **new_matrix(const int rows, const int cols)
+Scalar **new_matrix(const int rows, const int cols)
 {
-    double **row = (double **)malloc((rows) * sizeof(double *));
+    Scalar **row = (Scalar **)malloc((rows) * sizeof(Scalar *));
     for (int r = 0; r < rows; r++)
-        row[r] = (double *)malloc((cols) * sizeof(double));
+        row[r] = (Scalar *)malloc((cols) * sizeof(Scalar));
     return row;
 }
 
-static int current_seed = 0;
-
-/**
- * @brief Set the seed for random number generation.
- *
- * This function sets the seed for generating random numbers.
- *
- * @param seed The seed value to set.
- */
-void set_seed(const int seed)
-{
-    current_seed = seed;
-}
-
-/**
- * @brief Generate a random number.
- *
- * This function generates a random number using the current seed value.
- *
- * @return The generated random number.
- */
-int get_random(void)
-{
-    srand(current_seed);
-    current_seed = rand();
-    return rand();
-}
-
 static int progress_bar_step = 0;
 
 /**
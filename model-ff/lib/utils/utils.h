@@ -6,6 +6,8 @@
 
 #include <stdio.h>
 
+#include <scalar/scalar.h>
+
 /**
  * @brief The width of the progress bar.
  */
@@ -35,21 +37,7 @@ char *read_line_from_file(FILE *const file);
  * @param cols The number of columns in the matrix.
  * @return A dynamically allocated 2D array representing the matrix.
  */
-double **new_matrix(const int rows, const int cols);
-
-/**
- * @brief Sets the seed for the random number generator.
- *
- * @param seed The seed value to set.
- */
-void set_seed(const int seed);
-
-/**
- * @brief Generates a random integer.
- *
- * @return A random integer.
- */
-int get_random(void);
+Scalar **new_matrix(const int rows, const int cols);
 
 /**
  * @brief Calculates the number of lines in a file.
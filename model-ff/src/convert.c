@@ -0,0 +1,116 @@
+/**
+ * @file convert.c
+ * @brief Converts the text splits of datasets to the binary format loaded by dataset_split.
+ *
+ * Each train.txt, test.txt and validation.txt split found in the given dataset folders is parsed once and saved
+ * next to it as train.bin, test.bin and validation.bin. The binary splits are memory mapped when loaded, so
+ * clients starting on the same dataset share its pages instead of parsing their own copies.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <data/data.h>
+#include <logging/logging.h>
+#include <thread-pool/thread-pool.h>
+
+// Default conversion parameters.
+int num_classes = 10;
+int value_size = sizeof(Scalar); // The splits of the Scalar type are mapped in place by the loader.
+int num_threads = 1;
+
+// Pool parsing the text splits.
+ThreadPool *pool;
+
+void parse_args(int argc, char **argv, int *first_path);
+static void convert_dataset(const char *dataset_path);
+
+int main(int argc, char **argv)
+{
+    int first_path = argc;
+    parse_args(argc, argv, &first_path);
+    if (first_path == argc)
+    {
+        printf("No dataset path given, run %s -h for help\n", argv[0]);
+        return 1;
+    }
+
+    set_log_level(LOG_INFO);
+    open_log_file_with_timestamp("logs");
+    pool = new_thread_pool(num_threads);
+    for (int i = first_path; i < argc; i++)
+        convert_dataset(argv[i]);
+    free_thread_pool(pool);
+    close_log_file();
+    return 0;
+}
+
+static void convert_dataset(const char *dataset_path)
+{
+    const char *splits[] = {DATA_TEST_SPLIT, DATA_TRAIN_SPLIT, DATA_VALIDATION_SPLIT};
+    char text_path[256];
+    char binary_path[256];
+    int feature_len = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(text_path, sizeof(text_path), "%s/%s%s", dataset_path, splits[i], DATA_TEXT_EXTENSION);
+        snprintf(binary_path, sizeof(binary_path), "%s/%s%s", dataset_path, splits[i], DATA_BINARY_EXTENSION);
+        FILE *file = fopen(text_path, "r");
+        if (file == NULL)
+        {
+            printf("Skipping %s: not found\n", text_path);
+            continue;
+        }
+        fclose(file);
+
+        // All the splits have the number of inputs of the first one.
+        if (feature_len == 0)
+            feature_len = get_feature_len(text_path, num_classes);
+        Data *data = data_build_parallel(text_path, feature_len, num_classes, pool);
+        const double error = data_save_binary(data, binary_path, value_size);
+        printf("Converted %s to %s (%d samples, largest input error %g)\n", text_path, binary_path, data->rows, error);
+        free_data(data);
+    }
+}
+
+void parse_args(int argc, char **argv, int *first_path)
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        printf("Usage: %s [OPTIONS] DATASET_PATH...\n", argv[0]);
+        printf("Converts the text splits of each dataset to binary splits.\n");
+        printf("Options:\n");
+        printf("  -nc, --num_classes\tNumber of classes of the datasets (default: %d)\n", num_classes);
+        printf("  -vt, --value_type\tType of the stored values: uint8, float or double (default: %s)\n",
+               sizeof(Scalar) == sizeof(float) ? "float" : "double");
+        printf("\t\t\tuint8 requires non-negative features and one-hot labels\n");
+        printf("  -th, --threads\t\tNumber of threads parsing the text splits (default: %d)\n", num_threads);
+        exit(0);
+    }
+    int i = 1;
+    for (; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-nc") == 0 || strcmp(argv[i], "--num_classes") == 0)
+            num_classes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-th") == 0 || strcmp(argv[i], "--threads") == 0)
+            num_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-vt") == 0 || strcmp(argv[i], "--value_type") == 0)
+        {
+            i++;
+            if (strcmp(argv[i], "uint8") == 0)
+                value_size = 1;
+            else if (strcmp(argv[i], "float") == 0)
+                value_size = sizeof(float);
+            else if (strcmp(argv[i], "double") == 0)
+                value_size = sizeof(double);
+            else
+            {
+                printf("Invalid value type: %s\n", argv[i]);
+                exit(1);
+            }
+        }
+        else
+            break;
+    }
+    *first_path = i;
+}
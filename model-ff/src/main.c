@@ -20,12 +20,18 @@
  */
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <ff-net/ff-net.h>
 #include <data/data.h>
 #include <logging/logging.h>
 #include <utils/utils.h>
 #include <losses/losses.h>
+#include <thread-pool/thread-pool.h>
+#include <ff-quant/ff-quant.h>
+#include <ff-pipeline/ff-pipeline.h>
+#include <ff-prefetcher/ff-prefetcher.h>
+#include <rng/rng.h>
 
 #include <metrics.h>
 
@@ -44,22 +50,48 @@ int epochs = 5;
 int batch_size = 10;
 double threshold = 4.0;
 
+// Number of threads used for loading the dataset, training and evaluation.
+int num_threads = 1;
+
+// Pipelined training: each cell is trained by its own thread.
+bool pipelined = false;
+
+// Number of batches generated ahead of the training by a background thread, 0 to generate them synchronously.
+int prefetch_batches = 2;
+
+// Number of training steps of a cell between two weight statistics reports, 0 to disable them.
+int weight_stats_interval = 0;
+
+// Int8 quantization of the trained model, calibrated on the training split.
+bool quantize = false;
+int calibration_samples = 500;
+
+// Seed of the random streams: the initial weights, the shuffles and the negative labels.
+unsigned long seed = 0;
+
 Dataset data;
 FFNet *ffnet;
+ThreadPool *pool;
+Rng rng;
 
 void evaluate(void);
+void evaluate_quantized(void);
 void parse_args(int argc, char **argv);
 
 
-Metrics metrics;
+Predictions predictions;
 
 static void setup(void)
 {
-    // set_seed(time(NULL)); // comment for reproducibility
+    // seed = time(NULL); // comment for reproducibility
+    rng = new_rng(seed, 0);
+    set_ff_cell_stats_interval(weight_stats_interval);
     set_log_level(LOG_DEBUG);
     open_log_file_with_timestamp("logs");
 
-    data = dataset_split(dataset_path, num_classes);
+    pool = new_thread_pool(num_threads);
+
+    data = dataset_split_parallel(dataset_path, num_classes, pool);
     // Read the input size from the dataset and set the first layer size.
     input_size = data.train->feature_len;
     layers_sizes[0] = input_size;
@@ -68,7 +100,7 @@ static void setup(void)
     // load_ff_net(&ffnet, "ffnet.bin", relu, pdrelu, beta1, beta2, true);
 
     // Build the model from scratch.
-    ffnet = new_ff_net(layers_sizes, layers_number, relu, pdrelu, threshold, beta1, beta2, LOSS_TYPE_FF);
+    ffnet = new_ff_net(layers_sizes, layers_number, relu, pdrelu, threshold, beta1, beta2, LOSS_TYPE_FF, &rng);
 
     printf("Running with the following parameters:\n");
     printf("\tDataset path: %s\n", dataset_path);
@@ -76,6 +108,9 @@ static void setup(void)
     printf("\tEpochs: %d\n", epochs);
     printf("\tBatch size: %d\n", batch_size);
     printf("\tThreshold: %.2f\n", threshold);
+    printf("\tThreads: %d\n", num_threads);
+    printf("\tSeed: %lu\n", seed);
+    printf("\tPrefetched batches: %d\n", prefetch_batches);
     printf("\tLayer units: ");
     for (int i = 0; i < layers_number; i++)
     {
@@ -89,15 +124,25 @@ static void train_loop(void)
     clock_t start_time = clock();
     // Since batch is used for all layers, sample size is set to the maximum of the layers sizes.
     FFBatch batch = new_ff_batch(batch_size, max_int(layers_sizes, layers_number));
+    // Two batches per cell keep every cell busy while the next batch is generated.
+    FFPipeline *pipeline = pipelined ? new_ff_pipeline(ffnet, batch_size, max_int(layers_sizes, layers_number),
+                                                       2 * ffnet->num_cells)
+                                     : NULL;
+    FFPrefetcher *prefetcher = prefetch_batches > 0 ? new_ff_prefetcher(data.train, batch_size,
+                                                                        max_int(layers_sizes, layers_number),
+                                                                        prefetch_batches, &rng)
+                                                    : NULL;
 
     for (int i = 0; i < epochs; i++) // iterate over epochs
     {
         clock_t epoch_start_time = clock();
         printf("Epoch %d\n", i);
         log_info("Epoch %d", i);
-        shuffle_data(data.train);
+        shuffle_data(data.train, &rng);
         double loss = 0.0f;
         int num_batches = data.train->rows / batch_size;
+        if (prefetcher)
+            ff_prefetcher_begin_epoch(prefetcher, num_batches);
         // Print progress bar
         init_progress_bar();
 
@@ -106,9 +151,19 @@ static void train_loop(void)
             // Update progress bar
             update_progress_bar(j, num_batches);
 
-            generate_batch(data.train, j, batch); // generate positive and negative samples
-            loss += train_ff_net(ffnet, batch, learning_rate);
+            // generate positive and negative samples
+            FFBatch current = batch;
+            if (prefetcher)
+                current = ff_prefetcher_next(prefetcher);
+            else
+                generate_batch(data.train, j, batch, &rng);
+            if (pipeline)
+                ff_pipeline_push(pipeline, current, learning_rate);
+            else
+                loss += train_ff_net_parallel(ffnet, current, learning_rate, pool);
         }
+        if (pipeline)
+            loss = ff_pipeline_flush(pipeline);
         finish_progress_bar();
         printf("\tLoss %.12f\n", (double)loss / num_batches);
         int epoch_time = (clock() - epoch_start_time) / CLOCKS_PER_SEC;
@@ -122,38 +177,37 @@ static void train_loop(void)
     print_elapsed_time(total_time);
     printf("\n\n");
 
+    if (pipeline)
+        free_ff_pipeline(pipeline);
+    if (prefetcher)
+        free_ff_prefetcher(prefetcher);
     free_ff_batch(batch);
 }
 
 void evaluate(void)
 {
     log_info("Testing FFNet...");
-    init_predictions();
-    for (int i = 0; i < data.test->rows; i++)
-    {
-        double *const input = data.test->input[i];
-        double *const target = data.test->target[i];
-        int ground_truth = -1;
-        for (int j = 0; j < data.test->num_class; j++)
-        {
-            if (target[j] == 1.0f)
-            {
-                ground_truth = j;
-                break;
-            }
-        }
-        const int prediction = predict_ff_net(ffnet, input, num_classes, input_size);
-        add_prediction(ground_truth, prediction);
-    }
-    reset_metrics(metrics);
-    metrics = generate_metrics();
-    print_metrics(metrics);
+    const double loss = test_ff_net_parallel(ffnet, data.test, &predictions, pool);
+    printf("\tTest loss %.12f\n", loss);
+    // The confusion matrix is freed once printed.
+    print_metrics(generate_metrics(&predictions));
 
     // Save the model to a checkpoint file.
     save_ff_net(ffnet, "ffnet.bin", true);
     log_debug("FFNet saved to ffnet.bin");
 }
 
+void evaluate_quantized(void)
+{
+    log_info("Quantizing FFNet...");
+    FFQuantNet *qnet = quantize_ff_net(ffnet, data.train, calibration_samples);
+    print_ff_quant_report(compare_ff_quant_net(ffnet, qnet, data.test));
+
+    // Export the quantized model.
+    save_ff_quant_net(qnet, FFNET_CHECKPOINT_PATH "/ffnet-int8.bin");
+    free_ff_quant_net(qnet);
+}
+
 int main(int argc, char **argv)
 {
     parse_args(argc, argv);
@@ -164,9 +218,12 @@ int main(int argc, char **argv)
 
     printf("Testing...\n");
     evaluate();
+    if (quantize)
+        evaluate_quantized();
 
     free_dataset(data);
     free_ff_net(ffnet);
+    free_thread_pool(pool);
     close_log_file();
     return 0;
 }
@@ -190,6 +247,14 @@ void parse_args(int argc, char **argv)
         }
         printf(")\n");
         printf("  -dp, --dataset_path\tPath to the dataset (default: %s)\n", dataset_path);
+        printf("  -th, --threads\t\tNumber of threads for loading, training and evaluation (default: %d)\n", num_threads);
+        printf("  -pl, --pipeline\tTrain the cells in a pipeline, one thread per cell (default: disabled)\n");
+        printf("  -s,  --seed\t\tSeed of the random number generators (default: %lu)\n", seed);
+        printf("  -pf, --prefetch\tNumber of batches generated ahead by a background thread, 0 to disable (default: %d)\n",
+               prefetch_batches);
+        printf("  -ws, --weight-stats\tLog the weight statistics of each cell every N steps, 0 to disable (default: %d)\n",
+               weight_stats_interval);
+        printf("  -q,  --quantize\tQuantize the trained model to int8 and compare it (default: disabled)\n");
         exit(0);
     }
     for (int i = 1; i < argc; i++)
@@ -229,6 +294,34 @@ void parse_args(int argc, char **argv)
             dataset_path = argv[i + 1];
             i++;
         }
+        else if (strcmp(argv[i], "-th") == 0 || strcmp(argv[i], "--threads") == 0)
+        {
+            num_threads = atoi(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-pl") == 0 || strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipelined = true;
+        }
+        else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--seed") == 0)
+        {
+            seed = strtoul(argv[i + 1], NULL, 10);
+            i++;
+        }
+        else if (strcmp(argv[i], "-pf") == 0 || strcmp(argv[i], "--prefetch") == 0)
+        {
+            prefetch_batches = atoi(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-ws") == 0 || strcmp(argv[i], "--weight-stats") == 0)
+        {
+            weight_stats_interval = atoi(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quantize") == 0)
+        {
+            quantize = true;
+        }
         else
         {
             log_error("Unknown option: %s", argv[i]);